@@ -0,0 +1,163 @@
+#include "RoasterModel.h"
+#include "RoasterConfig.h"
+
+// Integration step in us; the fastest node (the heater) has a time
+// constant of several seconds, so explicit Euler is stable here
+#define MODEL_STEP 10000
+
+// Time constant of the reported heater duty (s)
+#define DUTY_AVERAGE 2.0
+
+#define WATER_SPECIFIC_HEAT 4186.0  // J/kg/K
+#define WATER_LATENT_HEAT 2.26e6    // J/kg
+
+RoasterModel::RoasterModel() {
+    probeCount = 0;
+    lastUs = 0;
+    zeroCrossPin = -1;
+    halfCycleUs = 0;
+    lastCrossUs = 0;
+    reset(defaults());
+}
+
+ModelParameters RoasterModel::defaults() {
+    ModelParameters p;
+    p.ambient = 25.0;
+    p.heaterWatts = 1800.0;
+    p.heaterCapacity = 150.0;
+    p.drumCapacity = 3000.0;
+    p.beanMass = 0.5;
+    p.beanSpecificHeat = 1400.0;
+    p.moisture = 0.11;
+    p.heaterToDrum = 10.0;
+    p.heaterToDrumFan = 20.0;
+    p.drumToBeans = 6.0;
+    p.drumToBeansFan = 8.0;
+    p.drumLoss = 3.0;
+    p.exhaustLoss = 6.0;
+    p.evaporationRate = 0.01;
+    p.probeLag = 2.0;
+    return p;
+}
+
+void RoasterModel::reset(const ModelParameters& parameters) {
+    params = parameters;
+    heaterTemp = params.ambient;
+    drumTemp = params.ambient;
+    heaterDuty = 0;
+    charge();
+    for (uint8_t i = 0; i < probeCount; i++) {
+        probes[i].reading = params.ambient;
+    }
+}
+
+void RoasterModel::preheat(double temp) {
+    heaterTemp = temp;
+    drumTemp = temp;
+}
+
+void RoasterModel::charge() {
+    beanTemp = params.ambient;
+    water = params.beanMass * params.moisture;
+}
+
+void RoasterModel::attach() {
+    lastUs = hal::now();
+    hal::addClockListener(clockListener, this);
+}
+
+int8_t RoasterModel::attachProbe(uint8_t csPin, ProbeLocation location) {
+    if (probeCount >= 4) {
+        return -1;
+    }
+    Probe& probe = probes[probeCount];
+    probe.model = this;
+    probe.location = location;
+    probe.reading = nodeTemp(location);
+    probe.open = false;
+    hal::attachSpiDevice(csPin, readProbe, &probe);
+    return probeCount++;
+}
+
+void RoasterModel::attachZeroCross(uint8_t pin, uint8_t mainsHz) {
+    zeroCrossPin = pin;
+    halfCycleUs = 500000UL / mainsHz;
+    lastCrossUs = hal::now();
+    hal::setPinInput(pin, LOW);
+}
+
+void RoasterModel::setProbeOpen(int8_t probe, bool open) {
+    if (probe >= 0 && probe < probeCount) {
+        probes[probe].open = open;
+    }
+}
+
+double RoasterModel::getHeaterDuty() {
+    return heaterDuty;
+}
+
+double RoasterModel::getFanDuty() {
+    return constrain(hal::pinOutput(FAN_PIN), 0, PWM_MAX) / (double)PWM_MAX;
+}
+
+double RoasterModel::nodeTemp(uint8_t location) {
+    return location == PROBE_DRUM ? drumTemp : beanTemp;
+}
+
+void RoasterModel::step(double dt) {
+    double heat = hal::pinOutput(HEAT_PIN) == HIGH ? 1.0 : 0.0;
+    double fan = getFanDuty();
+    heaterDuty += (heat - heaterDuty) * dt / (DUTY_AVERAGE + dt);
+
+    // Heat flows in watts
+    double input = heat * params.heaterWatts;
+    double toDrum = (params.heaterToDrum + params.heaterToDrumFan * fan) * (heaterTemp - drumTemp);
+    double toBeans = (params.drumToBeans + params.drumToBeansFan * fan) * (drumTemp - beanTemp);
+    double loss = (params.drumLoss + params.exhaustLoss * fan) * (drumTemp - params.ambient);
+
+    // Boiling off the bean water, faster the hotter the beans
+    double evaporated = 0;
+    if (beanTemp > 100.0 && water > 0) {
+        evaporated = params.evaporationRate * water * (beanTemp - 100.0) / 100.0 * dt;
+        evaporated = min(evaporated, water);
+    }
+
+    double beanCapacity = params.beanMass * params.beanSpecificHeat + water * WATER_SPECIFIC_HEAT;
+    heaterTemp += (input - toDrum) / params.heaterCapacity * dt;
+    drumTemp += (toDrum - toBeans - loss) / params.drumCapacity * dt;
+    beanTemp += (toBeans * dt - evaporated * WATER_LATENT_HEAT) / beanCapacity;
+    water -= evaporated;
+
+    // Thermocouples follow with a first-order lag
+    double alpha = dt / (params.probeLag + dt);
+    for (uint8_t i = 0; i < probeCount; i++) {
+        probes[i].reading += (nodeTemp(probes[i].location) - probes[i].reading) * alpha;
+    }
+}
+
+void RoasterModel::clockListener(uint64_t nowUs, void* context) {
+    RoasterModel* model = (RoasterModel*)context;
+    while (nowUs - model->lastUs >= MODEL_STEP) {
+        model->step(MODEL_STEP / 1e6);
+        model->lastUs += MODEL_STEP;
+    }
+    
+    // Detector pulses are short against a half-cycle; send the rising edge
+    while (model->zeroCrossPin >= 0 && nowUs - model->lastCrossUs >= model->halfCycleUs) {
+        model->lastCrossUs += model->halfCycleUs;
+        hal::setPinInput(model->zeroCrossPin, HIGH);
+        hal::setPinInput(model->zeroCrossPin, LOW);
+    }
+}
+
+// MAX6675 register: temperature in quarter degrees in bits 14..3,
+// bit 2 set for an open thermocouple
+uint16_t RoasterModel::readProbe(void* context) {
+    Probe* probe = (Probe*)context;
+    if (probe->open) {
+        return 0x0004;
+    }
+    long quarters = lround(probe->reading * 4.0);
+    quarters = constrain(quarters, 0L, 4095L);
+    return (uint16_t)(quarters << 3);
+}
@@ -0,0 +1,140 @@
+#ifndef ROASTER_MODEL_H
+#define ROASTER_MODEL_H
+
+#include <Arduino.h>
+
+// Where a simulated thermocouple sits
+enum ProbeLocation {
+    PROBE_BEANS,        // In the bean mass (BT)
+    PROBE_DRUM          // In the drum air (ET)
+};
+
+// Physical constants of the lumped model, SI units
+struct ModelParameters {
+    double ambient;             // Room temperature (°C)
+    double heaterWatts;         // Heater power at full output
+    double heaterCapacity;      // Heater element heat capacity (J/K)
+    double drumCapacity;        // Drum and air heat capacity (J/K)
+    double beanMass;            // Green bean charge (kg)
+    double beanSpecificHeat;    // Dry bean specific heat (J/kg/K)
+    double moisture;            // Water as a fraction of the charge
+    double heaterToDrum;        // Heater to drum conductance, fan off (W/K)
+    double heaterToDrumFan;     // Added at full fan (W/K)
+    double drumToBeans;         // Drum to bean conductance, fan off (W/K)
+    double drumToBeansFan;      // Added at full fan (W/K)
+    double drumLoss;            // Drum to room conductance (W/K)
+    double exhaustLoss;         // Added at full fan by the exhaust air (W/K)
+    double evaporationRate;     // Fraction of the water lost per second at 200°C (1/s)
+    double probeLag;            // Thermocouple time constant (s)
+};
+
+/**
+ * @class RoasterModel
+ * @brief Lumped thermal model of heater, drum and beans for the host build
+ *
+ * The model reads the SSR state on HEAT_PIN and the fan output on FAN_PIN
+ * and integrates three heat capacities in fixed MODEL_STEP steps as the
+ * simulated clock advances. Water in the beans boils off
+ * above 100°C and takes its latent heat with it, which flattens the rate
+ * of rise through drying as on a real roaster.
+ *
+ * Probes are MAX6675 devices on the simulated SPI bus, so the library
+ * reads them through its normal sensor driver.
+ */
+class RoasterModel {
+    private:
+        struct Probe {
+            RoasterModel* model;
+            uint8_t location;       // ProbeLocation
+            double reading;         // Lagged probe temperature
+            bool open;              // Report an open thermocouple
+        };
+
+        ModelParameters params;
+        double heaterTemp;
+        double drumTemp;
+        double beanTemp;
+        double water;               // Water left in the beans (kg)
+        double heaterDuty;          // Recent fraction of time the SSR was on
+        uint64_t lastUs;            // Simulated time integrated up to
+        Probe probes[4];
+        uint8_t probeCount;
+        int16_t zeroCrossPin;       // Detector output, -1 if not fitted
+        uint32_t halfCycleUs;       // Mains half-cycle
+        uint64_t lastCrossUs;       // Time of the last zero-cross pulse
+
+        /**
+         * @brief Integrate one MODEL_STEP
+         */
+        void step(double dt);
+
+        /**
+         * @brief Temperature at a probe location
+         */
+        double nodeTemp(uint8_t location);
+
+        static void clockListener(uint64_t nowUs, void* context);
+        static uint16_t readProbe(void* context);
+
+    public:
+        RoasterModel();
+
+        /**
+         * @brief Default parameters: 1.8 kW heater and a 500 g charge
+         */
+        static ModelParameters defaults();
+
+        /**
+         * @brief Set parameters and return to room temperature
+         */
+        void reset(const ModelParameters& parameters);
+
+        /**
+         * @brief Follow the simulated clock; call once before setup()
+         */
+        void attach();
+
+        /**
+         * @brief Add a MAX6675 on a chip select pin
+         * @return Probe index, or -1 if all are in use
+         */
+        int8_t attachProbe(uint8_t csPin, ProbeLocation location);
+
+        /**
+         * @brief Pulse a zero-cross detector input every mains half-cycle
+         */
+        void attachZeroCross(uint8_t pin, uint8_t mainsHz);
+        
+        /**
+         * @brief Make a probe report an open thermocouple
+         */
+        void setProbeOpen(int8_t probe, bool open);
+
+        /**
+         * @brief Bring the heater and drum to a temperature, as before a charge
+         */
+        void preheat(double temp);
+
+        /**
+         * @brief Drop in a fresh charge of green beans at room temperature
+         */
+        void charge();
+
+        double getHeaterTemp() { return heaterTemp; }
+        double getDrumTemp() { return drumTemp; }
+        double getBeanTemp() { return beanTemp; }
+
+        /**
+         * @brief Water left as a fraction of the charge
+         */
+        double getMoisture() { return water / params.beanMass; }
+
+        /**
+         * @brief Heater and fan outputs as 0..1; the heater is the SSR
+         * on-time averaged over the last couple of seconds
+         */
+        double getHeaterDuty();
+        double getFanDuty();
+};
+
+#endif
@@ -0,0 +1,429 @@
+// Host benchmarks of the control-loop hot paths
+//
+//   bench                    print the results
+//   bench -b baseline.txt    compare with a baseline, exit 1 on a regression
+//   bench -w baseline.txt    write the results as the new baseline
+//   bench -t percent         timing tolerance for -b (default 100)
+//   bench -l                 list the cases
+//
+// Allocation, primitive and pixel counts are deterministic and must not
+// grow at all. ns/op is host time and only catches gross slowdowns; the
+// primitive and pixel counts are what predict bus time on the real TFT.
+
+#include <Arduino.h>
+#include <SD.h>
+#include <MCUFRIEND_kbv.h>
+#include <TouchScreen.h>
+#include <getopt.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include "CoffeeRoasterController.h"
+#include "RoasterModel.h"
+
+// DisplayInterface.cpp refers to the sketch's panel
+MCUFRIEND_kbv tft;
+
+//===========================================
+// Allocation counting
+//===========================================
+
+static unsigned long allocatedBytes = 0;
+static bool countAllocations = true;
+
+void* operator new(size_t size) {
+    if (countAllocations) {
+        allocatedBytes += size;
+    }
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// Out of line so the compiler never pairs an inlined free() with new
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+//===========================================
+// Cases
+//===========================================
+
+// Chip selects of the benchmark sensors, clear of the roaster's own
+#define BENCH_SENSOR1_CS 30
+#define BENCH_SENSOR2_CS 31
+
+// Idle main loop passes advance the clock by this much in us
+#define BENCH_IDLE_STEP 1000
+
+struct BenchCase {
+    const char* name;
+    unsigned long iterations;
+    void (*setup)();
+    void (*op)();
+    const char* description;
+};
+
+struct Result {
+    std::string name;
+    double nsPerOp;
+    double bytesPerOp;
+    double primitivesPerOp;
+    double pixelsPerOp;
+};
+
+static unsigned long counter = 0;
+
+// RoR: one sensor sample per RoR interval on a rising ramp
+static uint16_t rampTemp = 100 * 4;
+static TempControl* rorControl = nullptr;
+
+static uint16_t rampDevice(void*) {
+    return (uint16_t)(rampTemp << 3);
+}
+
+static void setupRoR() {
+    static MAX6675SPI sensor1(BENCH_SENSOR1_CS);
+    static MAX6675SPI sensor2(BENCH_SENSOR2_CS);
+    hal::attachSpiDevice(BENCH_SENSOR1_CS, rampDevice, nullptr);
+    hal::attachSpiDevice(BENCH_SENSOR2_CS, rampDevice, nullptr);
+    rorControl = new TempControl(&sensor1, &sensor2);
+    rorControl->begin();
+}
+
+static void benchRoR() {
+    rampTemp = 400 + (counter++ % 600);
+    hal::advance((uint64_t)ROR_SAMPLE_INTERVAL * 1000);
+    rorControl->sample();
+    rorControl->getRateOfRise();
+}
+
+// PID: scheduled gains and one compute on a wandering temperature
+static PIDController* pid = nullptr;
+
+static void setupPid() {
+    pid = new PIDController();
+    pid->begin();
+    pid->setSetpoint(TEMP_C(200));
+    pid->reset(TEMP_C(190));
+}
+
+static void benchPid() {
+    temp_t temp = TEMP_C(190) + (temp_t)(counter++ % 2000);
+    pid->applySchedule(MAILLARD, temp);
+    pid->compute(temp, CONTROL_PERIOD);
+    pid->getOutput();
+}
+
+// Profile lookup: targets for every second of a stored 15 minute profile
+static SDWriteQueue* profileQueue = nullptr;
+static ProfileManager* profiles = nullptr;
+static uint16_t profileDuration = 0;
+
+static void setupProfile() {
+    profileQueue = new SDWriteQueue();
+    profiles = new ProfileManager(profileQueue);
+    profiles->begin();
+
+    // A curve with enough wiggle to need a keyframe every few seconds
+    profiles->createNewProfile();
+    for (unsigned long t = 0; t < 900; t++) {
+        double temp = 25 + t * 0.22 + 3 * sin(t / 7.0);
+        profiles->updateProfilePoint(t, (temp_t)(temp * TEMP_SCALE), 128 + (t / 30) % 64);
+        profileQueue->service();
+    }
+    profiles->saveProfile("bench");
+    profiles->loadProfile(0);
+    profileDuration = profiles->getCurrentProfile()->duration;
+}
+
+static void benchProfile() {
+    unsigned long t = counter++ % profileDuration;
+    if (t == 0) {
+        // Restarting playback opens the file, which allocates on the host
+        // SD shim but not on the card library
+        countAllocations = false;
+        profiles->loadProfile(0);
+        countAllocations = true;
+    }
+    profiles->getTargetTemp(t);
+    profiles->getTargetFan(t);
+    profiles->service();
+}
+
+// Drawing: a display with a full graph history
+static DisplayInterface* display = nullptr;
+
+static void nextFrame() {
+    hal::advance((uint64_t)UI_REFRESH_INTERVAL * 1000);
+}
+
+static void setupDisplay() {
+    display = new DisplayInterface(&tft);
+    display->begin();
+    for (int i = 0; i < GRAPH_WIDTH; i++) {
+        display->update(TEMP_C(100) + i * 50, TEMP_C(10), 128, 200);
+        nextFrame();
+        display->refresh();
+    }
+}
+
+static void benchGraph() {
+    display->redrawGraph();
+    nextFrame();
+    display->refresh();
+}
+
+static void benchSample() {
+    temp_t temp = TEMP_C(150) + (temp_t)(counter++ % 500) * 10;
+    display->update(temp, TEMP_C(8), 128, 200);
+    nextFrame();
+    display->refresh();
+}
+
+// Whole firmware: every task over one control period, mid-roast
+static RoasterModel* model = nullptr;
+static TaskScheduler* scheduler = nullptr;
+
+static void runFor(unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while ((long)(millis() - end) < 0) {
+        if (!scheduler->run()) {
+            hal::advance(BENCH_IDLE_STEP);
+        }
+    }
+}
+
+static void setupRoaster() {
+    static MAX6675SPI sensor1(TEMP1_CS);
+    static MAX6675SPI sensor2(TEMP2_CS);
+    static HeaterOutput heater(HEAT_PIN);
+    static FanOutput fan;
+    static TouchScreen touch(XP, YP, XM, YM, TS_RESISTANCE);
+
+    model = new RoasterModel();
+    model->preheat(200);
+    model->attach();
+    model->attachProbe(TEMP1_CS, PROBE_BEANS);
+    model->attachProbe(TEMP2_CS, PROBE_BEANS);
+    hal::setPinInput(EMERGENCY_STOP_PIN, HIGH);
+
+    TempControl* temp = new TempControl(&sensor1, &sensor2);
+    SDWriteQueue* queue = new SDWriteQueue();
+    RoasterControl* roaster = new RoasterControl(temp, new PIDController(),
+                                                 new DisplayInterface(&tft),
+                                                 new ProfileManager(queue),
+                                                 new RoastLogger(queue), queue, &heater, &fan);
+    roaster->begin();
+    scheduler = new TaskScheduler();
+    roaster->registerTasks(scheduler);
+
+    runFor(1000);
+    roaster->startRoast(false);
+    roaster->adjustHeat(100);
+    runFor(180000UL);
+}
+
+static void benchRoaster() {
+    runFor(CONTROL_PERIOD);
+}
+
+static const BenchCase cases[] = {
+    {"ror_sample",     200000, setupRoR,     benchRoR,     "TempControl::sample + getRateOfRise"},
+    {"pid_compute",   1000000, setupPid,     benchPid,     "PIDController::applySchedule + compute"},
+    {"profile_lookup", 200000, setupProfile, benchProfile, "ProfileManager target temp and fan, one second"},
+    {"draw_graph",        500, setupDisplay, benchGraph,   "Frame with a full graph repaint"},
+    {"draw_sample",      5000, nullptr,      benchSample,  "Frame with one new graph sample"},
+    {"roaster_period",   2400, setupRoaster, benchRoaster, "All tasks for one CONTROL_PERIOD"},
+};
+
+static const int caseCount = sizeof(cases) / sizeof(cases[0]);
+
+static Result runCase(const BenchCase& c) {
+    if (c.setup) {
+        c.setup();
+    }
+    counter = 0;
+    allocatedBytes = 0;
+    tft.resetCounters();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < c.iterations; i++) {
+        c.op();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    Result r;
+    r.name = c.name;
+    r.nsPerOp = std::chrono::duration<double, std::nano>(end - start).count() / c.iterations;
+    r.bytesPerOp = (double)allocatedBytes / c.iterations;
+    r.primitivesPerOp = (double)tft.getPrimitiveCount() / c.iterations;
+    r.pixelsPerOp = (double)tft.getPixelCount() / c.iterations;
+    return r;
+}
+
+//===========================================
+// Baselines
+//===========================================
+
+static int loadBaseline(const char* path, Result* baseline, int max) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    int count = 0;
+    char line[256];
+    char name[64];
+    while (count < max && fgets(line, sizeof(line), f)) {
+        Result& r = baseline[count];
+        if (line[0] != '#' && sscanf(line, "%63s %lf %lf %lf %lf", name, &r.nsPerOp,
+                                     &r.bytesPerOp, &r.primitivesPerOp, &r.pixelsPerOp) == 5) {
+            r.name = name;
+            count++;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static bool writeBaseline(const char* path, const Result* results, int count) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "# Benchmark baseline, written by bench -w\n");
+    fprintf(f, "# case ns/op bytes/op primitives/op pixels/op\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "%s %.1f %.1f %.2f %.1f\n", results[i].name.c_str(), results[i].nsPerOp,
+                results[i].bytesPerOp, results[i].primitivesPerOp, results[i].pixelsPerOp);
+    }
+    fclose(f);
+    return true;
+}
+
+// A count is a regression once it grows past rounding in the baseline file
+static bool countGrew(double now, double base) {
+    return now > base * 1.001 + 0.01;
+}
+
+static bool compare(const Result& now, const Result& base, double timeTolerance) {
+    bool ok = true;
+    if (countGrew(now.bytesPerOp, base.bytesPerOp)) {
+        printf("  REGRESSION %s: %.1f bytes/op allocated, baseline %.1f\n",
+               now.name.c_str(), now.bytesPerOp, base.bytesPerOp);
+        ok = false;
+    }
+    if (countGrew(now.primitivesPerOp, base.primitivesPerOp)) {
+        printf("  REGRESSION %s: %.2f primitives/op, baseline %.2f\n",
+               now.name.c_str(), now.primitivesPerOp, base.primitivesPerOp);
+        ok = false;
+    }
+    if (countGrew(now.pixelsPerOp, base.pixelsPerOp)) {
+        printf("  REGRESSION %s: %.1f pixels/op, baseline %.1f\n",
+               now.name.c_str(), now.pixelsPerOp, base.pixelsPerOp);
+        ok = false;
+    }
+    if (now.nsPerOp > base.nsPerOp * (1 + timeTolerance / 100)) {
+        printf("  REGRESSION %s: %.1f ns/op, baseline %.1f (+%.0f%% allowed)\n",
+               now.name.c_str(), now.nsPerOp, base.nsPerOp, timeTolerance);
+        ok = false;
+    }
+    if (ok && (now.primitivesPerOp < base.primitivesPerOp * 0.9
+               || now.pixelsPerOp < base.pixelsPerOp * 0.9)) {
+        printf("  %s draws well under its baseline; update it with -w\n", now.name.c_str());
+    }
+    return ok;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: bench [-b baseline] [-w baseline] [-t percent] [-l]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* baselinePath = nullptr;
+    const char* writePath = nullptr;
+    double timeTolerance = 100;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:w:t:lh")) != -1) {
+        switch (opt) {
+            case 'b': baselinePath = optarg; break;
+            case 'w': writePath = optarg; break;
+            case 't': timeTolerance = atof(optarg); break;
+            case 'l':
+                for (int i = 0; i < caseCount; i++) {
+                    printf("%-16s %s\n", cases[i].name, cases[i].description);
+                }
+                return 0;
+            default: usage(); return 2;
+        }
+    }
+
+    // A fresh card for every run, with free peripherals so simulated time
+    // only moves where a case moves it
+    char sdRoot[] = "/tmp/roaster-bench-XXXXXX";
+    if (!mkdtemp(sdRoot)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    hal::setSdRoot(sdRoot);
+    SPI.begin();
+    SD.begin(SD_CS);
+    tft.begin(tft.readID());
+    tft.setRotation(1);
+
+    Result results[caseCount];
+    printf("%-16s %9s %10s %10s %11s %12s\n", "case", "iters", "ns/op", "bytes/op",
+           "prims/op", "pixels/op");
+    for (int i = 0; i < caseCount; i++) {
+        results[i] = runCase(cases[i]);
+        printf("%-16s %9lu %10.1f %10.1f %11.2f %12.1f\n", cases[i].name, cases[i].iterations,
+               results[i].nsPerOp, results[i].bytesPerOp, results[i].primitivesPerOp,
+               results[i].pixelsPerOp);
+    }
+
+    std::string cleanup = std::string("rm -rf ") + sdRoot;
+    if (system(cleanup.c_str()) != 0) {
+        fprintf(stderr, "could not remove %s\n", sdRoot);
+    }
+
+    if (writePath && !writeBaseline(writePath, results, caseCount)) {
+        return 1;
+    }
+
+    if (baselinePath) {
+        Result baseline[32];
+        int baseCount = loadBaseline(baselinePath, baseline, 32);
+        if (baseCount < 0) {
+            return 1;
+        }
+        bool ok = true;
+        printf("\nagainst %s:\n", baselinePath);
+        for (int i = 0; i < caseCount; i++) {
+            int j = 0;
+            while (j < baseCount && baseline[j].name != results[i].name) {
+                j++;
+            }
+            if (j == baseCount) {
+                printf("  %s has no baseline\n", results[i].name.c_str());
+            } else {
+                ok = compare(results[i], baseline[j], timeTolerance) && ok;
+            }
+        }
+        printf("%s\n", ok ? "  no regressions" : "  FAILED");
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef HOST_ADAFRUIT_GFX_H
+#define HOST_ADAFRUIT_GFX_H
+
+// Host stand-in for Adafruit_GFX drawing into an RGB565 framebuffer.
+// Text is rendered as glyph cells; pixel and primitive counts model the
+// cost of the same calls on the real panel.
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+    protected:
+        int16_t rawWidth, rawHeight;
+        int16_t _width, _height;
+        uint8_t rotation;
+        int16_t cursorX, cursorY;
+        uint16_t textColor, textBgColor;
+        uint8_t textSize;
+        uint16_t* frame;
+        unsigned long pixelCount;
+        unsigned long primitiveCount;
+
+        void primitive(unsigned long pixels);
+        void plot(int16_t x, int16_t y, uint16_t color);
+
+    public:
+        Adafruit_GFX(int16_t w, int16_t h);
+        virtual ~Adafruit_GFX();
+
+        void drawPixel(int16_t x, int16_t y, uint16_t color);
+        void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+        void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+        void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+        void fillScreen(uint16_t color);
+        void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+        void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+        void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+        void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+        void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+        void setCursor(int16_t x, int16_t y) { cursorX = x; cursorY = y; }
+        void setTextColor(uint16_t c) { textColor = c; textBgColor = c; }
+        void setTextColor(uint16_t c, uint16_t bg) { textColor = c; textBgColor = bg; }
+        void setTextSize(uint8_t s) { textSize = s ? s : 1; }
+        void getTextBounds(const char* s, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+        size_t write(uint8_t c);
+        using Print::write;
+
+        int16_t width() { return _width; }
+        int16_t height() { return _height; }
+        void setRotation(uint8_t r);
+        uint8_t getRotation() { return rotation; }
+
+        // Host inspection
+        uint16_t pixel(int16_t x, int16_t y);
+        unsigned long getPixelCount() { return pixelCount; }
+        unsigned long getPrimitiveCount() { return primitiveCount; }
+        void resetCounters() { pixelCount = 0; primitiveCount = 0; }
+};
+
+namespace hal {
+
+// Simulated panel write cost, charged to the clock as drawing happens
+void setTftTiming(uint32_t usPerPrimitive, uint32_t nsPerPixel);
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host stand-in for the Arduino core: a simulated clock, recorded pin
+// state and a Serial that writes to stdout.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <avr/pgmspace.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define SS 53
+
+#define F(s) (s)
+
+#define PI 3.1415926535897932384626433832795
+
+using std::min;
+using std::max;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+class String {
+    private:
+        char buffer[64];
+    public:
+        String(const char* s = "");
+        String(int value);
+        String operator+(const String& other) const;
+        String operator+(const char* other) const;
+        const char* c_str() const { return buffer; }
+};
+
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t* data, size_t size);
+        size_t print(const char* s);
+        size_t print(const String& s) { return print(s.c_str()); }
+        size_t print(char c);
+        size_t print(int value);
+        size_t print(unsigned int value);
+        size_t print(long value);
+        size_t print(unsigned long value);
+        size_t print(double value, int digits = 2);
+        size_t println();
+        template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() { return 0; }
+        virtual int read() { return -1; }
+        virtual int peek() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+    public:
+        void begin(unsigned long) {}
+        size_t write(uint8_t c);
+        using Print::write;
+        int available();
+        int read();
+        operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Sketch entry points
+void setup();
+void loop();
+
+#include "HostHAL.h"
+
+#endif
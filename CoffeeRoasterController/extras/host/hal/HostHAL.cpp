@@ -0,0 +1,352 @@
+#include <Arduino.h>
+#include <string>
+
+namespace {
+
+const int PIN_COUNT = 70;
+
+uint64_t clockUs = 0;
+
+struct Listener {
+    hal::ClockListener fn;
+    void* context;
+};
+Listener listeners[8];
+int listenerCount = 0;
+
+int outputs[PIN_COUNT];
+uint8_t modes[PIN_COUNT];
+uint8_t inputs[PIN_COUNT];
+
+struct Timer {
+    hal::TimerIsr isr;
+    uint32_t period;
+    uint64_t due;
+};
+Timer timers[4];
+int timerCount = 0;
+
+struct Interrupt {
+    void (*isr)(void);
+    int mode;
+};
+Interrupt interruptTable[6];
+
+struct Device {
+    uint8_t cs;
+    hal::SpiDevice fn;
+    void* context;
+};
+Device devices[8];
+int deviceCount = 0;
+
+int16_t touchX = 0, touchY = 0, touchZ = 0;
+std::string serialQueue;
+std::string root = "sdcard";
+int interruptDepth = 0;
+
+}
+
+namespace hal {
+
+uint64_t now() {
+    return clockUs;
+}
+
+void advance(uint64_t us) {
+    uint64_t target = clockUs + us;
+    for (;;) {
+        // Stop at every timer tick on the way so the plant sees outputs
+        // change at the right time
+        uint64_t next = target;
+        for (int i = 0; i < timerCount; i++) {
+            next = std::min(next, timers[i].due);
+        }
+        clockUs = next;
+        for (int i = 0; i < listenerCount; i++) {
+            listeners[i].fn(clockUs, listeners[i].context);
+        }
+        for (int i = 0; i < timerCount; i++) {
+            if (timers[i].due <= clockUs) {
+                timers[i].due += timers[i].period;
+                timers[i].isr();
+            }
+        }
+        if (clockUs >= target) {
+            break;
+        }
+    }
+}
+
+void attachTimer(uint32_t periodUs, TimerIsr isr) {
+    int i = 0;
+    while (i < timerCount && timers[i].isr != isr) {
+        i++;
+    }
+    if (i == 4 || periodUs == 0) {
+        return;
+    }
+    timers[i].isr = isr;
+    timers[i].period = periodUs;
+    timers[i].due = clockUs + periodUs;
+    if (i == timerCount) {
+        timerCount++;
+    }
+}
+
+void addClockListener(ClockListener listener, void* context) {
+    if (listenerCount < 8) {
+        listeners[listenerCount].fn = listener;
+        listeners[listenerCount].context = context;
+        listenerCount++;
+    }
+}
+
+int pinOutput(uint8_t pin) {
+    return pin < PIN_COUNT ? outputs[pin] : 0;
+}
+
+uint8_t pinMode(uint8_t pin) {
+    return pin < PIN_COUNT ? modes[pin] : 0;
+}
+
+void setPinInput(uint8_t pin, uint8_t level) {
+    if (pin >= PIN_COUNT) {
+        return;
+    }
+    uint8_t previous = inputs[pin];
+    inputs[pin] = level;
+    int irq = digitalPinToInterrupt(pin);
+    if (irq < 0 || !interruptTable[irq].isr || previous == level) {
+        return;
+    }
+    int mode = interruptTable[irq].mode;
+    if (mode == CHANGE || (mode == FALLING && level == LOW) || (mode == RISING && level == HIGH)) {
+        interruptTable[irq].isr();
+    }
+}
+
+void attachSpiDevice(uint8_t csPin, SpiDevice device, void* context) {
+    if (deviceCount < 8) {
+        devices[deviceCount].cs = csPin;
+        devices[deviceCount].fn = device;
+        devices[deviceCount].context = context;
+        deviceCount++;
+    }
+}
+
+uint16_t spiTransfer() {
+    for (int i = 0; i < deviceCount; i++) {
+        if (outputs[devices[i].cs] == LOW && modes[devices[i].cs] == OUTPUT) {
+            return devices[i].fn(devices[i].context);
+        }
+    }
+    return 0xFFFF;
+}
+
+void setTouch(int16_t x, int16_t y, int16_t z) {
+    touchX = x;
+    touchY = y;
+    touchZ = z;
+}
+
+void getTouch(int16_t* x, int16_t* y, int16_t* z) {
+    *x = touchX;
+    *y = touchY;
+    *z = touchZ;
+}
+
+void serialInput(const char* text) {
+    serialQueue += text;
+}
+
+void setSdRoot(const char* path) {
+    root = path;
+}
+
+const char* sdRoot() {
+    return root.c_str();
+}
+
+}
+
+//===========================================
+// Arduino core
+//===========================================
+
+unsigned long millis() {
+    return (unsigned long)(clockUs / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)clockUs;
+}
+
+void delay(unsigned long ms) {
+    hal::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    hal::advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < PIN_COUNT) {
+        modes[pin] = mode;
+        if (mode == INPUT_PULLUP) {
+            inputs[pin] = HIGH;
+        }
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < PIN_COUNT) {
+        outputs[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= PIN_COUNT) {
+        return LOW;
+    }
+    return modes[pin] == OUTPUT ? outputs[pin] : inputs[pin];
+}
+
+void analogWrite(uint8_t pin, int value) {
+    if (pin < PIN_COUNT) {
+        outputs[pin] = value;
+    }
+}
+
+int analogRead(uint8_t) {
+    return 0;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+    // ATmega2560 external interrupts
+    switch (pin) {
+        case 2: return 0;
+        case 3: return 1;
+        case 21: return 2;
+        case 20: return 3;
+        case 19: return 4;
+        case 18: return 5;
+        default: return -1;
+    }
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode) {
+    if (interrupt < 6) {
+        interruptTable[interrupt].isr = isr;
+        interruptTable[interrupt].mode = mode;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+    if (interrupt < 6) {
+        interruptTable[interrupt].isr = nullptr;
+    }
+}
+
+void noInterrupts() {
+    interruptDepth++;
+}
+
+void interrupts() {
+    interruptDepth = 0;
+}
+
+//===========================================
+// String, Print and Serial
+//===========================================
+
+String::String(const char* s) {
+    strncpy(buffer, s, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+}
+
+String::String(int value) {
+    snprintf(buffer, sizeof(buffer), "%d", value);
+}
+
+String String::operator+(const String& other) const {
+    return *this + other.buffer;
+}
+
+String String::operator+(const char* other) const {
+    String result(buffer);
+    strncat(result.buffer, other, sizeof(result.buffer) - strlen(result.buffer) - 1);
+    return result;
+}
+
+size_t Print::write(const uint8_t* data, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        n += write(*data++);
+    }
+    return n;
+}
+
+size_t Print::print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t Print::print(int value) {
+    return print((long)value);
+}
+
+size_t Print::print(unsigned int value) {
+    return print((unsigned long)value);
+}
+
+size_t Print::print(long value) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%ld", value);
+    return print(buffer);
+}
+
+size_t Print::print(unsigned long value) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%lu", value);
+    return print(buffer);
+}
+
+size_t Print::print(double value, int digits) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+    return print(buffer);
+}
+
+size_t Print::println() {
+    return print("\r\n");
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (c != '\r') {
+        fputc(c, stdout);
+    }
+    return 1;
+}
+
+int HardwareSerial::available() {
+    return (int)serialQueue.size();
+}
+
+int HardwareSerial::read() {
+    if (serialQueue.empty()) {
+        return -1;
+    }
+    int c = (uint8_t)serialQueue[0];
+    serialQueue.erase(0, 1);
+    return c;
+}
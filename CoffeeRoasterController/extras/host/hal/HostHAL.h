@@ -0,0 +1,51 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+// Hooks the simulator uses to drive the host HAL: advance the simulated
+// clock, inspect outputs, feed inputs and attach SPI devices.
+
+#include <stdint.h>
+
+namespace hal {
+
+// Simulated time in microseconds since start
+uint64_t now();
+
+// Advance simulated time, running clock listeners on the way
+void advance(uint64_t us);
+
+// Called after every clock advance, e.g. to step a plant model
+typedef void (*ClockListener)(uint64_t nowUs, void* context);
+void addClockListener(ClockListener listener, void* context);
+
+// Periodic interrupt standing in for a hardware timer; clock listeners
+// see the time of every tick before the handler runs. Attaching the
+// same handler again changes its period
+typedef void (*TimerIsr)(void);
+void attachTimer(uint32_t periodUs, TimerIsr isr);
+
+// Pin state as last written by the sketch (analogWrite value for PWM pins)
+int pinOutput(uint8_t pin);
+uint8_t pinMode(uint8_t pin);
+
+// Drive an input pin, firing any attached interrupt
+void setPinInput(uint8_t pin, uint8_t level);
+
+// SPI devices answer transfer16 while their chip select is LOW
+typedef uint16_t (*SpiDevice)(void* context);
+void attachSpiDevice(uint8_t csPin, SpiDevice device, void* context);
+
+// Touch panel reading returned by the next TouchScreen::getPoint
+void setTouch(int16_t x, int16_t y, int16_t z);
+void getTouch(int16_t* x, int16_t* y, int16_t* z);
+
+// Bytes queued for Serial.read()
+void serialInput(const char* text);
+
+// Directory that backs the SD card
+void setSdRoot(const char* path);
+const char* sdRoot();
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include <SD.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct HostFile {
+    FILE* fp;
+    std::string name;
+    uint32_t pos;
+    bool append;
+    bool readable;
+    bool writable;
+    int refs;
+};
+
+SDClass SD;
+
+namespace {
+
+hal::SdTiming timing = {0, 0, 0, 0};
+hal::SdStats stats;
+unsigned long calls = 0;
+
+std::string hostPath(const char* path) {
+    std::string p = hal::sdRoot();
+    if (path[0] != '/') {
+        p += '/';
+    }
+    return p + path;
+}
+
+void cardAccess(size_t bytes) {
+    calls++;
+    uint64_t us = timing.callUs + (uint64_t)bytes * timing.byteUs16 / 16;
+    if (timing.stallEvery && calls % timing.stallEvery == 0) {
+        us += timing.stallUs;
+    }
+    if (us) {
+        hal::advance(us);
+    }
+}
+
+void release(HostFile* h) {
+    if (h && --h->refs == 0) {
+        if (h->fp) {
+            fclose(h->fp);
+        }
+        delete h;
+    }
+}
+
+}
+
+namespace hal {
+
+void setSdTiming(const SdTiming& t) {
+    timing = t;
+}
+
+const SdStats& sdStats() {
+    return stats;
+}
+
+void resetSdStats() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+}
+
+File::File(const File& other) : Stream(), handle(other.handle) {
+    if (handle) {
+        handle->refs++;
+    }
+}
+
+File& File::operator=(const File& other) {
+    if (other.handle) {
+        other.handle->refs++;
+    }
+    release(handle);
+    handle = other.handle;
+    return *this;
+}
+
+File::~File() {
+    release(handle);
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* data, size_t size) {
+    if (!handle || !handle->fp || !handle->writable) {
+        return 0;
+    }
+    if (handle->append) {
+        fseek(handle->fp, 0, SEEK_END);
+    } else {
+        fseek(handle->fp, handle->pos, SEEK_SET);
+    }
+    uint32_t start = ftell(handle->fp);
+    size_t n = fwrite(data, 1, size, handle->fp);
+    fflush(handle->fp);
+    handle->pos = ftell(handle->fp);
+    stats.writes++;
+    stats.bytesWritten += n;
+    if (start % 512 != 0 || size % 512 != 0) {
+        stats.unalignedWrites++;
+    }
+    cardAccess(n);
+    return n;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::read(void* buffer, uint16_t size) {
+    if (!handle || !handle->fp || !handle->readable) {
+        return -1;
+    }
+    fseek(handle->fp, handle->pos, SEEK_SET);
+    size_t n = fread(buffer, 1, size, handle->fp);
+    handle->pos += n;
+    stats.reads++;
+    stats.bytesRead += n;
+    cardAccess(n);
+    return (int)n;
+}
+
+int File::peek() {
+    if (!handle || !handle->fp) {
+        return -1;
+    }
+    fseek(handle->fp, handle->pos, SEEK_SET);
+    int c = fgetc(handle->fp);
+    return c == EOF ? -1 : c;
+}
+
+int File::available() {
+    if (!handle || !handle->fp) {
+        return 0;
+    }
+    uint32_t total = size();
+    return total > handle->pos ? total - handle->pos : 0;
+}
+
+void File::flush() {
+    if (handle && handle->fp) {
+        fflush(handle->fp);
+        cardAccess(0);
+    }
+}
+
+bool File::seek(uint32_t pos) {
+    if (!handle || !handle->fp || pos > size()) {
+        return false;
+    }
+    handle->pos = pos;
+    return true;
+}
+
+uint32_t File::position() {
+    return handle ? handle->pos : 0;
+}
+
+uint32_t File::size() {
+    if (!handle || !handle->fp) {
+        return 0;
+    }
+    long here = ftell(handle->fp);
+    fseek(handle->fp, 0, SEEK_END);
+    long end = ftell(handle->fp);
+    fseek(handle->fp, here, SEEK_SET);
+    return (uint32_t)end;
+}
+
+void File::close() {
+    if (handle && handle->fp) {
+        fclose(handle->fp);
+        handle->fp = nullptr;
+        cardAccess(0);
+    }
+    release(handle);
+    handle = nullptr;
+}
+
+const char* File::name() {
+    if (!handle) {
+        return "";
+    }
+    size_t slash = handle->name.rfind('/');
+    return handle->name.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+File::operator bool() {
+    return handle && handle->fp;
+}
+
+bool SDClass::begin(uint8_t) {
+    ::mkdir(hal::sdRoot(), 0777);
+    struct stat st;
+    return stat(hal::sdRoot(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+File SDClass::open(const char* path, uint8_t mode) {
+    std::string p = hostPath(path);
+    struct stat st;
+    bool exists = stat(p.c_str(), &st) == 0;
+    if (exists && S_ISDIR(st.st_mode)) {
+        return File();
+    }
+    if (!exists && !(mode & O_CREAT)) {
+        return File();
+    }
+    if (exists && (mode & O_EXCL)) {
+        return File();
+    }
+
+    const char* fmode;
+    if (!(mode & O_WRITE)) {
+        fmode = "rb";
+    } else if ((mode & O_TRUNC) || !exists) {
+        fmode = "w+b";
+    } else {
+        fmode = "r+b";
+    }
+    FILE* fp = fopen(p.c_str(), fmode);
+    if (!fp) {
+        return File();
+    }
+
+    HostFile* h = new HostFile;
+    h->fp = fp;
+    h->name = path;
+    h->pos = 0;
+    h->append = (mode & O_APPEND) != 0;
+    h->readable = (mode & O_READ) != 0;
+    h->writable = (mode & O_WRITE) != 0;
+    h->refs = 1;
+    if (h->append) {
+        fseek(fp, 0, SEEK_END);
+        h->pos = ftell(fp);
+    }
+    stats.opens++;
+    cardAccess(0);
+    return File(h);
+}
+
+bool SDClass::exists(const char* path) {
+    struct stat st;
+    cardAccess(0);
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool SDClass::mkdir(const char* path) {
+    cardAccess(0);
+    return ::mkdir(hostPath(path).c_str(), 0777) == 0;
+}
+
+bool SDClass::remove(const char* path) {
+    cardAccess(0);
+    return ::unlink(hostPath(path).c_str()) == 0;
+}
+
+bool SDClass::rmdir(const char* path) {
+    cardAccess(0);
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
@@ -0,0 +1,170 @@
+#include <Adafruit_GFX.h>
+#include <SPI.h>
+#include <Wire.h>
+
+SPIClass SPI;
+TwoWire Wire;
+
+namespace {
+
+uint32_t primitiveUs = 0;
+uint32_t pixelNs = 0;
+
+}
+
+namespace hal {
+
+void setTftTiming(uint32_t usPerPrimitive, uint32_t nsPerPixel) {
+    primitiveUs = usPerPrimitive;
+    pixelNs = nsPerPixel;
+}
+
+}
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) {
+    rawWidth = _width = w;
+    rawHeight = _height = h;
+    rotation = 0;
+    cursorX = cursorY = 0;
+    textColor = textBgColor = 0xFFFF;
+    textSize = 1;
+    frame = new uint16_t[(size_t)w * h]();
+    pixelCount = 0;
+    primitiveCount = 0;
+}
+
+Adafruit_GFX::~Adafruit_GFX() {
+    delete[] frame;
+}
+
+void Adafruit_GFX::primitive(unsigned long pixels) {
+    primitiveCount++;
+    pixelCount += pixels;
+    uint64_t us = primitiveUs + (uint64_t)pixels * pixelNs / 1000;
+    if (us) {
+        hal::advance(us);
+    }
+}
+
+void Adafruit_GFX::plot(int16_t x, int16_t y, uint16_t color) {
+    if (x >= 0 && y >= 0 && x < _width && y < _height) {
+        frame[(size_t)y * _width + x] = color;
+    }
+}
+
+uint16_t Adafruit_GFX::pixel(int16_t x, int16_t y) {
+    if (x < 0 || y < 0 || x >= _width || y >= _height) {
+        return 0;
+    }
+    return frame[(size_t)y * _width + x];
+}
+
+void Adafruit_GFX::setRotation(uint8_t r) {
+    rotation = r & 3;
+    _width = (rotation & 1) ? rawHeight : rawWidth;
+    _height = (rotation & 1) ? rawWidth : rawHeight;
+}
+
+void Adafruit_GFX::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    plot(x, y, color);
+    primitive(1);
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    for (int16_t i = 0; i < h; i++) {
+        plot(x, y + i, color);
+    }
+    primitive(h > 0 ? h : 0);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for (int16_t i = 0; i < w; i++) {
+        plot(x + i, y, color);
+    }
+    primitive(w > 0 ? w : 0);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t j = 0; j < h; j++) {
+        for (int16_t i = 0; i < w; i++) {
+            plot(x + i, y + j, color);
+        }
+    }
+    primitive(w > 0 && h > 0 ? (unsigned long)w * h : 0);
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+    fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    // Bresenham; the real library sends each pixel separately
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+    unsigned long pixels = 0;
+    while (true) {
+        plot(x0, y0, color);
+        pixels++;
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int16_t e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+    primitive(pixels);
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    drawFastHLine(x, y, w, color);
+    drawFastHLine(x, y + h - 1, w, color);
+    drawFastVLine(x, y, h, color);
+    drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t, uint16_t color) {
+    drawRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t, uint16_t color) {
+    fillRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size) {
+    // No font on the host: the background fills the 6x8 cell and the
+    // glyph is a solid 5x7 block, about what the real glyph costs
+    if (bg != color) {
+        for (int16_t j = 0; j < 8 * size; j++) {
+            for (int16_t i = 0; i < 6 * size; i++) {
+                plot(x + i, y + j, bg);
+            }
+        }
+    }
+    if (c != ' ') {
+        for (int16_t j = 0; j < 7 * size; j++) {
+            for (int16_t i = 0; i < 5 * size; i++) {
+                plot(x + i, y + j, color);
+            }
+        }
+    }
+    primitive((unsigned long)(bg != color ? 48 : 20) * size * size);
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+    if (c == '\n') {
+        cursorX = 0;
+        cursorY += 8 * textSize;
+    } else if (c != '\r') {
+        drawChar(cursorX, cursorY, c, textColor, textBgColor, textSize);
+        cursorX += 6 * textSize;
+    }
+    return 1;
+}
+
+void Adafruit_GFX::getTextBounds(const char* s, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+    *x1 = x;
+    *y1 = y;
+    *w = strlen(s) * 6 * textSize;
+    *h = 8 * textSize;
+}
@@ -0,0 +1,6 @@
+#ifndef HOST_LIQUIDCRYSTAL_H
+#define HOST_LIQUIDCRYSTAL_H
+
+// Included by CoffeeRoasterController.h; nothing in the library uses it
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_MCUFRIEND_KBV_H
+#define HOST_MCUFRIEND_KBV_H
+
+#include <Adafruit_GFX.h>
+
+class MCUFRIEND_kbv : public Adafruit_GFX {
+    public:
+        MCUFRIEND_kbv() : Adafruit_GFX(240, 320) {}
+        uint16_t readID() { return 0x9341; }
+        void begin(uint16_t) { fillScreen(0); resetCounters(); }
+        void vertScroll(int16_t, int16_t, int16_t) {}
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+// Host stand-in for the Arduino SD library, backed by a directory on
+// the host filesystem (hal::setSdRoot). Open flags follow SdFat.
+
+#include <Arduino.h>
+
+#define O_READ   0x01
+#define O_RDONLY O_READ
+#define O_WRITE  0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR   (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_SYNC   0x08
+#define O_CREAT  0x10
+#define O_EXCL   0x20
+#define O_TRUNC  0x40
+
+#define FILE_READ  O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+struct HostFile;
+
+class File : public Stream {
+    private:
+        HostFile* handle;
+    public:
+        File() : handle(nullptr) {}
+        explicit File(HostFile* h) : handle(h) {}
+        File(const File& other);
+        File& operator=(const File& other);
+        ~File();
+        size_t write(uint8_t c);
+        size_t write(const uint8_t* data, size_t size);
+        using Print::write;
+        int read();
+        int read(void* buffer, uint16_t size);
+        int peek();
+        int available();
+        void flush();
+        bool seek(uint32_t pos);
+        uint32_t position();
+        uint32_t size();
+        void close();
+        const char* name();
+        operator bool();
+};
+
+class SDClass {
+    public:
+        bool begin(uint8_t csPin = SS);
+        File open(const char* path, uint8_t mode = FILE_READ);
+        File open(const String& path, uint8_t mode = FILE_READ) { return open(path.c_str(), mode); }
+        bool exists(const char* path);
+        bool exists(const String& path) { return exists(path.c_str()); }
+        bool mkdir(const char* path);
+        bool remove(const char* path);
+        bool rmdir(const char* path);
+};
+
+extern SDClass SD;
+
+namespace hal {
+
+// Card latency model: every call into the card costs this much
+// simulated time, plus a stall every stallEvery calls
+struct SdTiming {
+    uint32_t callUs;
+    uint32_t byteUs16;      // Per-byte cost in 1/16 us
+    uint32_t stallUs;
+    uint32_t stallEvery;
+};
+void setSdTiming(const SdTiming& timing);
+
+struct SdStats {
+    unsigned long opens;
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long bytesRead;
+    unsigned long bytesWritten;
+    unsigned long unalignedWrites;  // Writes not covering whole 512-byte sectors
+};
+const SdStats& sdStats();
+void resetSdStats();
+
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+
+class SPISettings {
+    public:
+        SPISettings() {}
+        SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+namespace hal {
+uint16_t spiTransfer();
+}
+
+// Transfers are answered by the device whose chip select is LOW
+class SPIClass {
+    public:
+        void begin() {}
+        void beginTransaction(SPISettings) {}
+        void endTransaction() {}
+        uint8_t transfer(uint8_t) { return hal::spiTransfer() >> 8; }
+        uint16_t transfer16(uint16_t) { return hal::spiTransfer(); }
+};
+
+extern SPIClass SPI;
+
+#endif
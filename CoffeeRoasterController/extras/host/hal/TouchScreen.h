@@ -0,0 +1,24 @@
+#ifndef HOST_TOUCHSCREEN_H
+#define HOST_TOUCHSCREEN_H
+
+#include <Arduino.h>
+
+class TSPoint {
+    public:
+        TSPoint() : x(0), y(0), z(0) {}
+        TSPoint(int16_t x0, int16_t y0, int16_t z0) : x(x0), y(y0), z(z0) {}
+        int16_t x, y, z;
+};
+
+// Returns the reading set with hal::setTouch
+class TouchScreen {
+    public:
+        TouchScreen(uint8_t, uint8_t, uint8_t, uint8_t, uint16_t) {}
+        TSPoint getPoint() {
+            TSPoint p;
+            hal::getTouch(&p.x, &p.y, &p.z);
+            return p;
+        }
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+class TwoWire {
+    public:
+        void begin() {}
+};
+
+extern TwoWire Wire;
+
+#endif
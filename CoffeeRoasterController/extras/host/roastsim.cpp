@@ -0,0 +1,257 @@
+// Host roast simulator: runs the firmware sketch against RoasterModel on
+// a simulated clock, faster than real time.
+//
+//   roastsim [-d seconds] [-s setpoint] [-c charge] [-p slot] [-o trace.csv] [-r sdroot] [-i] [-a] [-e second] [-k second] [-x]
+
+#include <Arduino.h>
+#include <SD.h>
+#include <MCUFRIEND_kbv.h>
+#include <getopt.h>
+#include <time.h>
+#include "CoffeeRoasterController.h"
+#include "RoasterModel.h"
+
+// Objects owned by the sketch (main.ino)
+extern MCUFRIEND_kbv tft;
+extern TempControl* tempControl;
+extern DisplayInterface* display;
+extern ProfileManager* profiles;
+extern SDWriteQueue* sdQueue;
+extern RoasterControl* roaster;
+extern TaskScheduler* scheduler;
+
+// Time charged for a main loop pass that finds no task due, in us
+#define LOOP_PASS_US 20
+
+static const char* stageNames[] = {
+    "idle", "charging", "drying", "maillard", "first crack",
+    "development", "cooling", "emergency stop"
+};
+
+static const char* tripNames[] = {
+    "none", "button", "over temperature", "sensor fault", "stale sample", "control"
+};
+
+static RoasterModel model;
+
+static double toDegrees(temp_t temp) {
+    return temp / (double)TEMP_SCALE;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: roastsim [-d seconds] [-s setpoint] [-c charge] [-p slot] [-o trace.csv] [-r sdroot] [-i] [-a] [-e second] [-k second] [-x]\n"
+            "  -d  roast length in simulated seconds (default 720)\n"
+            "  -s  manual setpoint in degrees C (default 210)\n"
+            "  -c  drum temperature at charge in degrees C (default 200)\n"
+            "  -p  play back the profile in this slot instead\n"
+            "  -o  write a CSV trace, one row per second\n"
+            "  -r  directory backing the SD card (default sdcard)\n"
+            "  -i  ideal peripherals: no SD or TFT latency\n"
+            "  -a  autotune the PID first, then recharge and roast with the result\n"
+            "  -e  press the emergency stop for a second at this time\n"
+            "  -k  stall the main loop for 3 s at this time, as a hung card would\n"
+            "  -x  swap the BT and ET probes, as a miswired roaster would\n");
+}
+
+// Run the sketch until the simulated clock reaches a time in ms
+static void runUntil(unsigned long endMs) {
+    while (millis() < endMs) {
+        if (!scheduler->run()) {
+            hal::advance(LOOP_PASS_US);
+        }
+    }
+}
+
+static void printTaskStats() {
+    printf("\ntask period    runs    over late ms  max us\n");
+    for (uint8_t i = 0; i < scheduler->getTaskCount(); i++) {
+        const Task* task = scheduler->getTask(i);
+        printf("%-4u %6u %7lu %7lu %7lu %7lu\n", i, task->period, task->runs,
+               task->overruns, task->maxLateness, task->maxRunTime);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long duration = 720;
+    int setpoint = 210;
+    int slot = -1;
+    double preheat = 200;
+    const char* tracePath = nullptr;
+    const char* sdRoot = "sdcard";
+    bool ideal = false;
+    bool tune = false;
+    long stopAt = -1;
+    long stallAt = -1;
+    bool swapProbes = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:c:p:o:r:iae:k:xh")) != -1) {
+        switch (opt) {
+            case 'd': duration = strtoul(optarg, nullptr, 10); break;
+            case 's': setpoint = atoi(optarg); break;
+            case 'c': preheat = atof(optarg); break;
+            case 'p': slot = atoi(optarg); break;
+            case 'o': tracePath = optarg; break;
+            case 'r': sdRoot = optarg; break;
+            case 'i': ideal = true; break;
+            case 'a': tune = true; break;
+            case 'e': stopAt = atol(optarg); break;
+            case 'k': stallAt = atol(optarg); break;
+            case 'x': swapProbes = true; break;
+            default: usage(); return 2;
+        }
+    }
+
+    FILE* trace = nullptr;
+    if (tracePath && !(trace = fopen(tracePath, "w"))) {
+        perror(tracePath);
+        return 1;
+    }
+
+    // Peripheral costs of the Mega with an 8-bit parallel ILI9341 shield
+    // and a typical SD card on SPI, including occasional write stalls
+    hal::setSdRoot(sdRoot);
+    if (!ideal) {
+        hal::setTftTiming(20, 150);
+        hal::SdTiming sdTiming = {300, 16, 25000, 100};
+        hal::setSdTiming(sdTiming);
+    }
+
+    model.preheat(preheat);
+    model.attach();
+    model.attachProbe(TEMP1_CS, swapProbes ? PROBE_DRUM : PROBE_BEANS);
+    model.attachProbe(TEMP2_CS, swapProbes ? PROBE_BEANS : PROBE_DRUM);
+    model.attachZeroCross(HEATER_ZERO_CROSS_PIN, HEATER_MAINS_HZ);
+    hal::setPinInput(EMERGENCY_STOP_PIN, HIGH);
+
+    setup();
+    if (!scheduler) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+
+    // Let the sensors settle, then charge the preheated drum
+    runUntil(millis() + 1000);
+    if (tune) {
+        unsigned long tuneStart = millis();
+        if (!roaster->startAutotune()) {
+            fprintf(stderr, "autotune did not start\n");
+            return 1;
+        }
+        while (roaster->isAutotuning()) {
+            runUntil(millis() + 1000);
+        }
+        PIDAutotune* autotune = roaster->getAutotune();
+        if (autotune->getState() != AUTOTUNE_DONE) {
+            fprintf(stderr, "autotune failed after %lu s\n", (millis() - tuneStart) / 1000);
+            return 1;
+        }
+        GainSet gains = autotune->getGains();
+        printf("autotune: %u cycles in %lu s, Ku %.2f, Pu %.1f s, Kp %.2f Ki %.4f Kd %.2f%s\n\n",
+               autotune->getCycles(), (millis() - tuneStart) / 1000,
+               autotune->getUltimateGain(), autotune->getUltimatePeriod(),
+               gains.kp / (double)PID_GAIN_SCALE, gains.ki / (double)PID_GAIN_SCALE,
+               gains.kd / (double)PID_GAIN_SCALE,
+               autotune->gainsLimited() ? " (scaled down to fit PID_MAX_GAIN)" : "");
+        // Recharge and let the probes and their filters catch up
+        model.preheat(preheat);
+        model.charge();
+        runUntil(millis() + 10000);
+    }
+    if (slot >= 0) {
+        if (!profiles->loadProfile(slot)) {
+            fprintf(stderr, "no profile in slot %d\n", slot);
+            return 1;
+        }
+        roaster->startRoast(true);
+    } else {
+        roaster->startRoast(false);
+        int delta = setpoint - (int)toDegrees(roaster->getTargetTemp());
+        while (delta != 0) {
+            int8_t stepSize = constrain(delta, -100, 100);
+            roaster->adjustHeat(stepSize);
+            delta -= stepSize;
+        }
+    }
+
+    if (trace) {
+        fprintf(trace, "time,bean,drum,heater,bt_probe,target,heat,fan,moisture,stage\n");
+    }
+    printf(" time     BT   drum  target heat  fan  stage\n");
+
+    clock_t wallStart = clock();
+    unsigned long start = millis();
+    unsigned long disagreeSeconds = 0;
+    for (unsigned long second = 0; second <= duration; second++) {
+        if ((long)second == stallAt) {
+            // Only interrupts run while the loop is stuck
+            hal::advance(3000000);
+        }
+        runUntil(start + second * 1000);
+        if ((long)second == stopAt) {
+            hal::setPinInput(EMERGENCY_STOP_PIN, LOW);
+        } else if ((long)second == stopAt + 1) {
+            hal::setPinInput(EMERGENCY_STOP_PIN, HIGH);
+        }
+
+        if (tempControl->channelsDisagree()) {
+            disagreeSeconds++;
+        }
+        double target = toDegrees(roaster->getTargetTemp());
+        const char* stage = stageNames[roaster->getCurrentStage()];
+        if (trace) {
+            fprintf(trace, "%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%.4f,%s\n", second,
+                    model.getBeanTemp(), model.getDrumTemp(), model.getHeaterTemp(),
+                    toDegrees(tempControl->getTemp(CHANNEL_BT)), target, model.getHeaterDuty(),
+                    model.getFanDuty(), model.getMoisture(), stage);
+        }
+        if (second % 60 == 0) {
+            printf("%2lu:%02lu %6.1f %6.1f %6.1f %3.0f%% %3.0f%%  %s\n", second / 60, second % 60,
+                   model.getBeanTemp(), model.getDrumTemp(), target,
+                   model.getHeaterDuty() * 100, model.getFanDuty() * 100, stage);
+        }
+    }
+    double wall = (double)(clock() - wallStart) / CLOCKS_PER_SEC;
+
+#ifdef ROASTER_PROFILING
+    // Ask the firmware for its own report and give it time to print
+    printf("\n");
+    fflush(stdout);
+    hal::serialInput("p");
+    runUntil(millis() + 2000);
+#endif
+
+    printTaskStats();
+
+    SafetyInterlock* interlock = roaster->getInterlock();
+    if (interlock->getTripCount() == 0) {
+        printf("\nsafety: 0 trips, checks at most %lu us apart\n", interlock->getMaxCheckGap());
+    } else {
+        uint8_t reason = interlock->getReason();
+        printf("\nsafety: %u trips (%s), stop handler %lu us, ", interlock->getTripCount(),
+               tripNames[reason], interlock->getMaxStopTime());
+        if (reason == TRIP_OVER_TEMP || reason == TRIP_SENSOR_FAULT || reason == TRIP_STALE_SAMPLE) {
+            printf("watchdog tripped on a %lu ms old sample, ", interlock->getMaxDetectTime());
+        }
+        printf("checks at most %lu us apart\n", interlock->getMaxCheckGap());
+    }
+    printf("probes: disagreed for %lu s\n", disagreeSeconds);
+
+    const hal::SdStats& sd = hal::sdStats();
+    printf("\nsd: %lu opens, %lu reads (%lu bytes), %lu writes (%lu bytes, %lu unaligned), "
+           "queue peak %u bytes, longest write %lu us, %lu bytes dropped, %lu write errors\n",
+           sd.opens, sd.reads, sd.bytesRead, sd.writes, sd.bytesWritten, sd.unalignedWrites,
+           sdQueue->getHighWater(), sdQueue->getLongestStall(),
+           sdQueue->getDroppedBytes(), sdQueue->getWriteErrors());
+    printf("tft: %lu primitives, %lu pixels, %lu frames dropped, worst pass %lu us\n",
+           tft.getPrimitiveCount(), tft.getPixelCount(),
+           display->getFramesDropped(), display->getWorstFrameTime());
+    printf("simulated %lu s in %.2f s (%.0fx real time)\n",
+           duration, wall, wall > 0 ? duration / wall : 0.0);
+
+    if (trace) {
+        fclose(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,672 @@
+// Host tests of library behaviour that the simulated roast does not pin down
+//
+//   tests        run every test, exit 1 on a failure
+//   tests name   run the named tests
+//   tests -l     list the tests
+
+#include <Arduino.h>
+#include <SD.h>
+#include <getopt.h>
+#include <string>
+#include <string.h>
+#include "CoffeeRoasterController.h"
+
+//===========================================
+// Harness
+//===========================================
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        long long checkA = (long long)(a); \
+        long long checkB = (long long)(b); \
+        if (checkA != checkB) { \
+            printf("  %s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                   __FILE__, __LINE__, #a, #b, checkA, checkB); \
+            failures++; \
+        } \
+    } while (0)
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+    const char* description;
+};
+
+//===========================================
+// PID
+//===========================================
+
+// Run the controller for a while at a steady measurement
+static void runPid(PIDController* pid, temp_t temp, long steps) {
+    for (long i = 0; i < steps; i++) {
+        pid->compute(temp, CONTROL_PERIOD);
+    }
+}
+
+// A long saturated stretch must not wind the integrator past the output
+static void testPidWindup() {
+    PIDController pid;
+    pid.begin();
+    pid.tune(KP_CONS, KI_CONS, 0);
+    pid.setSetpoint(TEMP_C(200));
+
+    // Ten minutes far below the setpoint
+    runPid(&pid, TEMP_C(20), 600000L / CONTROL_PERIOD);
+    CHECK_EQ(pid.getOutput(), PWM_MAX);
+
+    // Just past the setpoint the output comes off the limit at once, and
+    // the integrator unwinds in seconds rather than minutes
+    runPid(&pid, TEMP_C(201), 1);
+    CHECK(pid.getOutput() < PWM_MAX);
+    runPid(&pid, TEMP_C(201), 30000L / CONTROL_PERIOD);
+    CHECK_EQ(pid.getOutput(), PWM_MIN);
+}
+
+// Changing gains leaves the output where it was
+static void testPidBumpless() {
+    PIDController pid;
+    pid.begin();
+    pid.setSetpoint(TEMP_C(150));
+
+    // Close below the setpoint the output is mostly integral, inside the limits
+    temp_t temp = TEMP_C(149.5);
+    runPid(&pid, temp, 40);
+    uint8_t before = pid.getOutput();
+    CHECK(before > PWM_MIN && before < PWM_MAX);
+
+    // A zero time step recomputes the output without integrating
+    pid.tune(KP_AGG, KI_AGG, KD_AGG);
+    pid.compute(temp, 0);
+    CHECK(abs((int)pid.getOutput() - before) <= 1);
+    pid.tune(KP_CONS / 2, KI_CONS / 2, KD_CONS / 2);
+    pid.compute(temp, 0);
+    CHECK(abs((int)pid.getOutput() - before) <= 1);
+}
+
+// The output saturates at the limits and never wraps around them
+static void testPidLimits() {
+    PIDController pid;
+    pid.begin();
+    pid.tune(KP_AGG, KI_AGG, KD_AGG);
+    pid.setSetpoint(TEMP_C(MAX_TEMP));
+
+    runPid(&pid, TEMP_C(0), 1);
+    CHECK_EQ(pid.getOutput(), PWM_MAX);
+    runPid(&pid, TEMP_C(-50), 100);
+    CHECK_EQ(pid.getOutput(), PWM_MAX);
+
+    pid.setSetpoint(TEMP_C(0));
+    runPid(&pid, TEMP_C(MAX_TEMP), 100);
+    CHECK_EQ(pid.getOutput(), PWM_MIN);
+
+    // A faulted reading turns the heater off
+    pid.setSetpoint(TEMP_C(MAX_TEMP));
+    runPid(&pid, TEMP_C(20), 10);
+    CHECK_EQ(pid.getOutput(), PWM_MAX);
+    runPid(&pid, TEMP_INVALID, 1);
+    CHECK_EQ(pid.getOutput(), PWM_MIN);
+}
+
+//===========================================
+// Temperatures
+//===========================================
+
+// Readings served on the sensor chip selects, TEMP_INVALID for an open probe
+static temp_t probeTemps[2];
+
+static uint16_t readTestProbe(void* context) {
+    temp_t temp = *(temp_t*)context;
+    if (temp == TEMP_INVALID) {
+        return 0x0004;
+    }
+    return (uint16_t)(temp * 4 / TEMP_SCALE) << 3;
+}
+
+static void attachTestProbes() {
+    hal::attachSpiDevice(TEMP1_CS, readTestProbe, &probeTemps[0]);
+    hal::attachSpiDevice(TEMP2_CS, readTestProbe, &probeTemps[1]);
+}
+
+// Least-squares RoR recovers the slope of a ramp
+static void testRorRamp() {
+    attachTestProbes();
+    MAX6675SPI sensor1(TEMP1_CS);
+    MAX6675SPI sensor2(TEMP2_CS);
+    TempControl temps(&sensor1, &sensor2);
+    temps.begin();
+
+    // 12 C a minute in 0.25 C steps, the MAX6675 resolution
+    const temp_t rate = TEMP_C(12);
+    unsigned long start = millis();
+    for (int i = 0; i < 4 * 90; i++) {
+        temp_t temp = TEMP_C(100) + rate * (millis() - start) / 60000;
+        probeTemps[0] = probeTemps[1] = temp - temp % 25;
+        temps.sample();
+        delay(TEMP_SAMPLE_INTERVAL);
+    }
+    CHECK(abs(temps.getRateOfRise() - rate) <= rate / 50);
+
+    // A shorter window fits the same line
+    temps.setRoRWindow(10);
+    CHECK(abs(temps.getRateOfRise() - rate) <= rate / 20);
+
+    // A faulted probe restarts the fit, so the ramp before it is forgotten
+    probeTemps[0] = probeTemps[1] = TEMP_INVALID;
+    delay(ROR_SAMPLE_INTERVAL);
+    temps.sample();
+    probeTemps[0] = probeTemps[1] = TEMP_C(150);
+    for (int i = 0; i < 4 * 5; i++) {
+        delay(TEMP_SAMPLE_INTERVAL);
+        temps.sample();
+    }
+    CHECK_EQ(temps.getRateOfRise(), 0);
+}
+
+// Sample both probes every TEMP_SAMPLE_INTERVAL for a stretch of time
+static void sampleProbes(TempControl* temps, unsigned long ms) {
+    for (unsigned long t = 0; t < ms; t += TEMP_SAMPLE_INTERVAL) {
+        temps->sample();
+        delay(TEMP_SAMPLE_INTERVAL);
+    }
+}
+
+// Each filter type passes, blends or smooths readings as documented
+static void testChannelFilter() {
+    TempChannel none(FILTER_NONE);
+    none.addSample(TEMP_C(100), 0);
+    none.addSample(TEMP_C(110), TEMP_SAMPLE_INTERVAL);
+    CHECK_EQ(none.getTemp(), TEMP_C(110));
+
+    // The EMA moves a quarter of the way to each new reading
+    TempChannel ema(FILTER_EMA);
+    ema.addSample(TEMP_C(100), 0);
+    CHECK_EQ(ema.getTemp(), TEMP_C(100));
+    ema.addSample(TEMP_C(110), TEMP_SAMPLE_INTERVAL);
+    CHECK_EQ(ema.getTemp(), TEMP_C(100) + TEMP_C(10) * TEMP_EMA_WEIGHT / 256);
+    for (int i = 2; i < 60; i++) {
+        ema.addSample(TEMP_C(110), i * TEMP_SAMPLE_INTERVAL);
+    }
+    CHECK_EQ(ema.getTemp(), TEMP_C(110));
+
+    // The Kalman filter takes its first reading as is, then smooths noise
+    // to well under its amplitude and still follows a step
+    TempChannel kalman(FILTER_KALMAN);
+    kalman.addSample(TEMP_C(150), 0);
+    CHECK_EQ(kalman.getTemp(), TEMP_C(150));
+    temp_t worst = 0;
+    for (int i = 1; i < 200; i++) {
+        kalman.addSample(TEMP_C(150) + (i % 2 ? TEMP_C(1) : -TEMP_C(1)), i * TEMP_SAMPLE_INTERVAL);
+        CHECK_EQ(kalman.getRaw(), TEMP_C(150) + (i % 2 ? TEMP_C(1) : -TEMP_C(1)));
+        if (i > 20) {
+            worst = max(worst, (temp_t)abs(kalman.getTemp() - TEMP_C(150)));
+        }
+    }
+    CHECK(worst < TEMP_C(1) / 2);
+    for (int i = 200; i < 240; i++) {
+        kalman.addSample(TEMP_C(160), i * TEMP_SAMPLE_INTERVAL);
+    }
+    CHECK(abs(kalman.getTemp() - TEMP_C(160)) < TEMP_C(1) / 2);
+
+    // A fault invalidates the channel, and the next reading restarts it
+    kalman.addSample(TEMP_INVALID, 240 * TEMP_SAMPLE_INTERVAL);
+    CHECK_EQ(kalman.getTemp(), TEMP_INVALID);
+    kalman.addSample(TEMP_C(120), 241 * TEMP_SAMPLE_INTERVAL);
+    CHECK_EQ(kalman.getTemp(), TEMP_C(120));
+}
+
+// BT and ET out of agreement count only once it has lasted CHANNEL_DISAGREE_TIME
+static void testChannelDisagree() {
+    attachTestProbes();
+    MAX6675SPI sensor1(TEMP1_CS);
+    MAX6675SPI sensor2(TEMP2_CS);
+    TempControl temps(&sensor1, &sensor2);
+    probeTemps[0] = TEMP_C(50);
+    probeTemps[1] = TEMP_C(100);
+    temps.begin();
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME * 2);
+    CHECK(!temps.channelsDisagree());
+    CHECK_EQ(temps.getTemp(CHANNEL_AVERAGE), TEMP_C(75));
+    CHECK_EQ(temps.getTemp(CHANNEL_HOTTEST), TEMP_C(100));
+
+    // ET far above BT: a probe out of place
+    probeTemps[1] = TEMP_C(50 + CHANNEL_MAX_SPREAD + 30);
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME / 2);
+    CHECK(!temps.channelsDisagree());
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME);
+    CHECK(temps.channelsDisagree());
+
+    // Agreement clears it at once
+    probeTemps[1] = TEMP_C(100);
+    sampleProbes(&temps, 5000);
+    CHECK(!temps.channelsDisagree());
+
+    // BT well above ET: swapped probes
+    probeTemps[0] = TEMP_C(100 + CHANNEL_MAX_INVERSION + 20);
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME / 2);
+    CHECK(!temps.channelsDisagree());
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME);
+    CHECK(temps.channelsDisagree());
+
+    // A faulted probe is a safety fault, not a disagreement
+    probeTemps[1] = TEMP_INVALID;
+    sampleProbes(&temps, CHANNEL_DISAGREE_TIME);
+    CHECK(!temps.channelsDisagree());
+    CHECK(!temps.checkSafety(CHANNEL_HOTTEST));
+    CHECK(temps.checkSafety(CHANNEL_BT));
+}
+
+//===========================================
+// Touch
+//===========================================
+
+// Scan the panel every sample interval with the given reading
+static void touchScans(TouchInput* input, int16_t z, int scans) {
+    for (int i = 0; i < scans; i++) {
+        hal::setTouch((TS_LEFT + TS_RT) / 2, (TS_TOP + TS_BOT) / 2, z);
+        input->poll();
+        delay(TOUCH_SAMPLE_INTERVAL);
+    }
+}
+
+// A tap is one press and one release, and single-scan glitches are ignored
+static void testTouchDebounce() {
+    TouchScreen ts(XP, YP, XM, YM, TS_RESISTANCE);
+    TouchInput input(&ts);
+    TouchEvent event;
+    const int16_t down = (TOUCH_MIN_PRESSURE + TOUCH_MAX_PRESSURE) / 2;
+
+    // A glitch shorter than the debounce count is no touch
+    touchScans(&input, down, TOUCH_DEBOUNCE_SAMPLES - 1);
+    touchScans(&input, 0, 1);
+    CHECK(!input.getEvent(&event));
+    CHECK(!input.isTouched());
+
+    touchScans(&input, down, TOUCH_DEBOUNCE_SAMPLES);
+    CHECK(input.isTouched());
+    CHECK(input.getEvent(&event));
+    CHECK_EQ(event.type, TOUCH_PRESS);
+    CHECK(abs(event.x - SCREEN_WIDTH / 2) <= 1);
+    CHECK(abs(event.y - SCREEN_HEIGHT / 2) <= 1);
+
+    // Nor does a lift shorter than the debounce count end the touch
+    touchScans(&input, 0, TOUCH_DEBOUNCE_SAMPLES - 1);
+    touchScans(&input, down, 1);
+    touchScans(&input, 0, TOUCH_DEBOUNCE_SAMPLES);
+    CHECK(!input.isTouched());
+    CHECK(input.getEvent(&event));
+    CHECK_EQ(event.type, TOUCH_RELEASE);
+    CHECK(!input.getEvent(&event));
+
+    // Out-of-range pressure is no touch
+    touchScans(&input, TOUCH_MAX_PRESSURE + 1, TOUCH_DEBOUNCE_SAMPLES);
+    CHECK(!input.getEvent(&event));
+}
+
+// Held touches repeat; events queue in order and a full queue drops new ones
+static void testTouchQueue() {
+    TouchScreen ts(XP, YP, XM, YM, TS_RESISTANCE);
+    TouchInput input(&ts);
+    TouchEvent event;
+    const int16_t down = (TOUCH_MIN_PRESSURE + TOUCH_MAX_PRESSURE) / 2;
+
+    // Press, then hold through the first repeat
+    int repeatScans = TOUCH_REPEAT_DELAY / TOUCH_SAMPLE_INTERVAL + 1;
+    touchScans(&input, down, TOUCH_DEBOUNCE_SAMPLES + repeatScans);
+    CHECK(input.getEvent(&event));
+    CHECK_EQ(event.type, TOUCH_PRESS);
+    CHECK(input.getEvent(&event));
+    CHECK_EQ(event.type, TOUCH_REPEAT);
+    CHECK(!input.getEvent(&event));
+
+    // Hold long enough to queue more repeats than fit, unread
+    int intervalScans = TOUCH_REPEAT_INTERVAL / TOUCH_SAMPLE_INTERVAL;
+    touchScans(&input, down, (TOUCH_QUEUE_SIZE + 2) * intervalScans);
+    CHECK_EQ(input.getOverflows(), 2);
+    touchScans(&input, 0, TOUCH_DEBOUNCE_SAMPLES);
+    CHECK_EQ(input.getOverflows(), 3);
+
+    int queued = 0;
+    while (input.getEvent(&event)) {
+        CHECK_EQ(event.type, TOUCH_REPEAT);
+        queued++;
+    }
+    CHECK_EQ(queued, TOUCH_QUEUE_SIZE);
+}
+
+//===========================================
+// Scheduler
+//===========================================
+
+struct TestTask {
+    unsigned long runs;
+    unsigned long busyMs;       // Simulated run time
+    int order;                  // Position among the runs, -1 before any
+};
+
+static int taskRunOrder;
+
+static void runTestTask(void* context) {
+    TestTask* task = (TestTask*)context;
+    task->runs++;
+    task->order = taskRunOrder++;
+    delay(task->busyMs);
+}
+
+// Run the scheduler for a stretch of simulated time in 1 ms steps
+static void runScheduler(TaskScheduler* scheduler, unsigned long ms) {
+    unsigned long start = millis();
+    while (millis() - start < ms) {
+        while (scheduler->run()) {
+        }
+        delay(1);
+    }
+}
+
+// Tasks run once per period without drift; the lower priority number first
+static void testSchedulerPeriods() {
+    TaskScheduler scheduler;
+    TestTask fast = {0, 0, -1};
+    TestTask slow = {0, 0, -1};
+    taskRunOrder = 0;
+    int8_t slowId = scheduler.addTask(runTestTask, &slow, 250, 1);
+    int8_t fastId = scheduler.addTask(runTestTask, &fast, 100, 0);
+    CHECK(scheduler.addTask(runTestTask, &fast, 0, 0) < 0);
+
+    // Both are due at once; priority decides, not the order added
+    CHECK(scheduler.run());
+    CHECK_EQ(fast.order, 0);
+    runScheduler(&scheduler, 10000);
+    CHECK_EQ(fast.runs, 100);
+    CHECK_EQ(slow.runs, 40);
+    CHECK_EQ(scheduler.getTask(fastId)->overruns, 0);
+    CHECK_EQ(scheduler.getTask(slowId)->overruns, 0);
+    CHECK(scheduler.getTask(fastId)->maxLateness <= 1);
+    CHECK(scheduler.getTask(2) == nullptr);
+
+    // The table holds SCHEDULER_MAX_TASKS
+    while (scheduler.getTaskCount() < SCHEDULER_MAX_TASKS) {
+        CHECK(scheduler.addTask(runTestTask, &fast, 1000, 2) >= 0);
+    }
+    CHECK(scheduler.addTask(runTestTask, &fast, 1000, 2) < 0);
+}
+
+// A run that blocks for whole periods of another task counts them as overruns
+static void testSchedulerOverruns() {
+    TaskScheduler scheduler;
+    TestTask fast = {0, 0, -1};
+    TestTask blocking = {0, 0, -1};
+    int8_t fastId = scheduler.addTask(runTestTask, &fast, 100, 0);
+    int8_t blockingId = scheduler.addTask(runTestTask, &blocking, 1000, 1, 50);
+    runScheduler(&scheduler, 1000);
+    CHECK_EQ(fast.runs, 10);
+
+    // One 350 ms run skips three 100 ms periods of the fast task
+    blocking.busyMs = 350;
+    runScheduler(&scheduler, 1000);
+    const Task* stats = scheduler.getTask(fastId);
+    CHECK_EQ(stats->overruns, 3);
+    CHECK(stats->maxLateness >= 300);
+    CHECK_EQ(fast.runs, 10 + 10 - 3);
+    CHECK(scheduler.getTask(blockingId)->maxRunTime >= 350000UL);
+
+    // The cadence restarts from the late run instead of bursting to catch up
+    blocking.busyMs = 0;
+    unsigned long runs = fast.runs;
+    runScheduler(&scheduler, 1000);
+    CHECK_EQ(fast.runs - runs, 10);
+
+    scheduler.resetStats();
+    CHECK_EQ(scheduler.getTask(fastId)->overruns, 0);
+    CHECK_EQ(scheduler.getTask(fastId)->runs, 0);
+}
+
+//===========================================
+// Profiles
+//===========================================
+
+struct ProfileSample {
+    unsigned long time;
+    temp_t temp;
+    uint8_t fan;
+};
+
+// Record the samples, save them and load them back for playback
+static void recordProfile(ProfileManager* profiles, SDWriteQueue* queue,
+                          const ProfileSample* samples, int count) {
+    profiles->createNewProfile();
+    for (int i = 0; i < count; i++) {
+        profiles->updateProfilePoint(samples[i].time, samples[i].temp, samples[i].fan);
+        queue->service();
+    }
+    CHECK(profiles->saveProfile("test"));
+    CHECK(profiles->loadProfile(profiles->getProfileCount() - 1));
+}
+
+// Largest playback error over the samples, in temp_t and fan steps
+static void playbackError(ProfileManager* profiles, const ProfileSample* samples, int count,
+                          int32_t* tempError, int32_t* fanError) {
+    *tempError = 0;
+    *fanError = 0;
+    for (int i = 0; i < count; i++) {
+        int32_t dt = abs((int32_t)profiles->getTargetTemp(samples[i].time) - samples[i].temp);
+        int32_t df = abs((int32_t)profiles->getTargetFan(samples[i].time) - samples[i].fan);
+        *tempError = max(*tempError, dt);
+        *fanError = max(*fanError, df);
+        profiles->service();
+    }
+}
+
+// Every recorded point plays back within the recording tolerances
+static void testProfileTolerance() {
+    SDWriteQueue queue;
+    ProfileManager profiles(&queue);
+    CHECK(profiles.begin());
+    int32_t tempError, fanError;
+
+    // The end of the anchor-to-last-point line is 1.4 C off the middle point
+    const ProfileSample bend[] = {
+        {0, TEMP_C(0), 0}, {1, TEMP_C(0), 0}, {2, 280, 0}, {3, 420, 0}, {4, 560, 0},
+    };
+    int bendCount = sizeof(bend) / sizeof(bend[0]);
+    recordProfile(&profiles, &queue, bend, bendCount);
+    playbackError(&profiles, bend, bendCount, &tempError, &fanError);
+    CHECK(tempError <= PROFILE_TEMP_TOLERANCE);
+    CHECK(fanError <= PROFILE_FAN_TOLERANCE);
+
+    // A roast-like ramp with probe noise and fan steps
+    static ProfileSample roast[900];
+    int roastCount = sizeof(roast) / sizeof(roast[0]);
+    uint32_t seed = 1;
+    for (int i = 0; i < roastCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        double noise = (int)((seed >> 16) % 101 - 50) / 100.0;
+        roast[i].time = i;
+        roast[i].temp = (temp_t)((25 + i * 0.22 + 3 * sin(i / 7.0) + noise) * TEMP_SCALE);
+        roast[i].fan = 128 + (i / 30) % 64 + (seed >> 24) % 5;
+    }
+    recordProfile(&profiles, &queue, roast, roastCount);
+    playbackError(&profiles, roast, roastCount, &tempError, &fanError);
+    CHECK(tempError <= PROFILE_TEMP_TOLERANCE);
+    CHECK(fanError <= PROFILE_FAN_TOLERANCE);
+    CHECK(profiles.getCurrentProfile()->keyframeCount < roastCount);
+}
+
+// The setpoint lookahead stays inside the window with a keyframe every 2 s
+static void testProfileLookahead() {
+    SDWriteQueue queue;
+    ProfileManager profiles(&queue);
+    CHECK(profiles.begin());
+
+    // A zigzag about a ramp: a corner every 2 s, straight lines between
+    static ProfileSample zigzag[901];
+    int count = sizeof(zigzag) / sizeof(zigzag[0]);
+    for (int i = 0; i < count; i += 2) {
+        int side = (i / 2) % 2 ? 1 : -1;
+        zigzag[i].time = i;
+        zigzag[i].temp = TEMP_C(100) + i * 20 + side * TEMP_C(3);
+        zigzag[i].fan = 128 + side * 20;
+    }
+    for (int i = 1; i < count; i += 2) {
+        zigzag[i].time = i;
+        zigzag[i].temp = (zigzag[i - 1].temp + zigzag[i + 1].temp) / 2;
+        zigzag[i].fan = (zigzag[i - 1].fan + zigzag[i + 1].fan) / 2;
+    }
+    recordProfile(&profiles, &queue, zigzag, count);
+    CHECK(profiles.getCurrentProfile()->keyframeCount >= count / 2);
+
+    // Lookups as RoasterControl makes them, with storage runs between
+    int mismatches = 0;
+    for (int t = 0; t + PROFILE_LOOKAHEAD < count - 1; t++) {
+        mismatches += profiles.getTargetFan(t) != zigzag[t].fan;
+        mismatches += profiles.getTargetTemp(t + PROFILE_LOOKAHEAD) != zigzag[t + PROFILE_LOOKAHEAD].temp;
+        mismatches += profiles.getTargetSlope(t + PROFILE_LOOKAHEAD) == 0;
+        for (int i = 0; i < 4; i++) {
+            profiles.service();
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(profiles.getUnderruns(), 0);
+}
+
+//===========================================
+// Gains
+//===========================================
+
+// Gains past PID_MAX_GAIN are scaled down together, keeping their ratios
+static void testGainLimit() {
+    // Relay result of the simulated roaster, Kd far past the limit
+    GainSet tuned = makeGainSet(14.47, 0.0567, 411.6);
+    uint16_t limit = (uint16_t)(PID_MAX_GAIN * PID_GAIN_SCALE);
+    CHECK_EQ(tuned.kd, limit);
+    CHECK(fabs((double)tuned.kd / tuned.kp - 411.6 / 14.47) < 0.05);
+
+    GainSchedule schedule;
+    CHECK(schedule.retune(tuned));
+    for (uint8_t stage = 0; stage < ROAST_STAGE_COUNT; stage++) {
+        GainSet first = schedule.lookup((RoastStage)stage, 0);
+        CHECK_EQ(first.kd, tuned.kd);
+        for (uint8_t band = 0; band < GAIN_BAND_COUNT; band++) {
+            GainSet cell = schedule.lookup((RoastStage)stage, schedule.getBand(band));
+            CHECK(cell.kp <= limit && cell.ki <= limit && cell.kd <= limit);
+        }
+    }
+
+    // Gains inside the limit are left alone
+    GainSchedule gentle;
+    CHECK(!gentle.retune(makeGainSet(KP_CONS, KI_CONS, KD_CONS)));
+}
+
+//===========================================
+// Heater
+//===========================================
+
+// Burst fire switches whole cycles of ticks. The simulated timer ticks
+// exactly on the half-cycles, as zero-cross pulses would, so that means
+// no half-wave DC
+static void testHeaterPolarity() {
+    // Outlives the test; the half-cycle timer keeps calling it
+    static HeaterOutput heater(HEAT_PIN);
+    heater.begin();
+    heater.setMode(HEATER_BURST_FIRE);
+
+    const uint8_t duties[] = {1, 64, 128, 200, PWM_MAX};
+    for (uint8_t d = 0; d < sizeof(duties); d++) {
+        heater.setDuty(duties[d]);
+
+        // Even half-cycles have one polarity and odd ones the other; the
+        // difference between them is the DC the load sees
+        const long halfCycles = 2 * PWM_MAX * 4;
+        long on = 0;
+        long imbalance = 0;
+        long worstImbalance = 0;
+        for (long i = 0; i < halfCycles; i++) {
+            hal::advance(1000000UL / (2 * HEATER_MAINS_HZ));
+            on += heater.isOn();
+            imbalance += heater.isOn() ? (i % 2 ? -1 : 1) : 0;
+            worstImbalance = max(worstImbalance, abs(imbalance));
+        }
+        CHECK(worstImbalance <= 1);
+        CHECK(abs(on - halfCycles * duties[d] / PWM_MAX) <= 2);
+    }
+    heater.off();
+}
+
+//===========================================
+// Main
+//===========================================
+
+static const TestCase tests[] = {
+    {"pid_windup", testPidWindup, "saturation does not wind up the integrator"},
+    {"pid_bumpless", testPidBumpless, "gain changes leave the output in place"},
+    {"pid_limits", testPidLimits, "output saturates at the PWM limits"},
+    {"ror_ramp", testRorRamp, "rate of rise matches a known ramp"},
+    {"channel_filter", testChannelFilter, "none, EMA and Kalman filters behave as documented"},
+    {"channel_disagree", testChannelDisagree, "lasting BT/ET disagreement is detected"},
+    {"touch_debounce", testTouchDebounce, "a tap is one press and one release"},
+    {"touch_queue", testTouchQueue, "repeats queue in order, overflow is counted"},
+    {"scheduler_periods", testSchedulerPeriods, "tasks run once a period by priority"},
+    {"scheduler_overruns", testSchedulerOverruns, "late runs count overruns and skip"},
+    {"profile_tolerance", testProfileTolerance, "recorded points play back within tolerance"},
+    {"profile_lookahead", testProfileLookahead, "setpoint lookahead never outruns the window"},
+    {"gain_limit", testGainLimit, "tuned gains past PID_MAX_GAIN keep their ratios"},
+    {"heater_polarity", testHeaterPolarity, "burst fire has as many on half-cycles of each polarity"},
+};
+static const int testCount = sizeof(tests) / sizeof(tests[0]);
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "lh")) != -1) {
+        switch (opt) {
+            case 'l':
+                for (int i = 0; i < testCount; i++) {
+                    printf("%-20s %s\n", tests[i].name, tests[i].description);
+                }
+                return 0;
+            default:
+                fprintf(stderr, "usage: tests [-l] [name...]\n");
+                return 2;
+        }
+    }
+
+    char sdRoot[] = "/tmp/roaster-tests-XXXXXX";
+    if (!mkdtemp(sdRoot)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    hal::setSdRoot(sdRoot);
+    SPI.begin();
+    SD.begin(SD_CS);
+
+    int run = 0;
+    for (int i = 0; i < testCount; i++) {
+        bool selected = optind == argc;
+        for (int a = optind; a < argc; a++) {
+            selected = selected || strcmp(argv[a], tests[i].name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        int before = failures;
+        tests[i].run();
+        printf("%-20s %s\n", tests[i].name, failures == before ? "ok" : "FAILED");
+        run++;
+    }
+
+    std::string cleanup = std::string("rm -rf ") + sdRoot;
+    if (system(cleanup.c_str()) != 0) {
+        fprintf(stderr, "could not remove %s\n", sdRoot);
+    }
+
+    printf("%d tests, %d failures\n", run, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Convert a CoffeeRoasterController roast log (roastNNN.bin) to CSV.
+
+Usage: roastlog2csv.py roast001.bin [output.csv]
+
+The log layout is defined by RoastLogHeader and RoastLogRecord in
+src/RoasterConfig.h: one header block, then blocks of packed
+little-endian records. Writes to stdout when no output file is given.
+"""
+
+import csv
+import struct
+import sys
+
+LOG_MAGIC = 0x474F4C52
+LOG_VERSION = 1
+LOG_FLAG_VALID = 0x01
+LOG_FLAG_MANUAL = 0x02
+LOG_FLAG_SENSOR = 0x04
+LOG_FLAG_DISAGREE = 0x08
+TEMP_INVALID = -32768
+
+HEADER = struct.Struct("<IBBHHHHI20s")
+RECORD = struct.Struct("<IhhhhBBBB")
+
+STAGES = ["IDLE", "CHARGING", "DRYING", "MAILLARD", "FIRST_CRACK",
+          "DEVELOPMENT", "COOLING", "EMERGENCY_STOP"]
+
+
+def read_log(data):
+    (magic, version, record_size, block_size, interval, temp_scale,
+     roast_number, record_count, profile) = HEADER.unpack_from(data, 0)
+    if magic != LOG_MAGIC:
+        raise ValueError("not a roast log")
+    if version != LOG_VERSION or record_size != RECORD.size:
+        raise ValueError("unsupported log version %d" % version)
+
+    header = {
+        "roast": roast_number,
+        "interval": interval,
+        "profile": profile.split(b"\0", 1)[0].decode("ascii", "replace"),
+    }
+
+    # A log that was never closed has no count; its records end at the
+    # first one without the valid flag (block padding or unwritten space)
+    records = []
+    for offset in range(block_size, len(data) - RECORD.size + 1, RECORD.size):
+        if record_count and len(records) >= record_count:
+            break
+        fields = RECORD.unpack_from(data, offset)
+        if not fields[8] & LOG_FLAG_VALID:
+            break
+        records.append(fields)
+    return header, temp_scale, records
+
+
+def temp(value, scale):
+    if value == TEMP_INVALID:
+        return ""
+    return "%.2f" % (value / scale)
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write(__doc__)
+        return 2
+
+    with open(argv[1], "rb") as f:
+        header, scale, records = read_log(f.read())
+
+    out = open(argv[2], "w", newline="") if len(argv) == 3 else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(["time_s", "bt_c", "et_c", "ror_c_per_min",
+                     "setpoint_c", "heat", "fan", "stage", "manual",
+                     "sensor_fault", "probes_disagree"])
+    for time, t1, t2, ror, setpoint, heat, fan, stage, flags in records:
+        writer.writerow([
+            "%.3f" % (time / 1000.0),
+            temp(t1, scale),
+            temp(t2, scale),
+            temp(ror, scale),
+            temp(setpoint, scale),
+            heat,
+            fan,
+            STAGES[stage] if stage < len(STAGES) else stage,
+            1 if flags & LOG_FLAG_MANUAL else 0,
+            1 if flags & LOG_FLAG_SENSOR else 0,
+            1 if flags & LOG_FLAG_DISAGREE else 0,
+        ])
+    if out is not sys.stdout:
+        out.close()
+
+    sys.stderr.write("roast %d, profile '%s': %d records\n"
+                     % (header["roast"], header["profile"], len(records)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
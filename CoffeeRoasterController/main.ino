@@ -2,30 +2,74 @@
 #include <SD.h>
 #include <MCUFRIEND_kbv.h>
 #include <TouchScreen.h>
-#include <max6675.h>
 #include <Wire.h>
 #include "CoffeeRoasterController.h"
 
 // Initialize display
 MCUFRIEND_kbv tft;
 
-// Touch screen configuration
-const int MINPRESSURE = 200;
-const int MAXPRESSURE = 1000;
-
 // Create touch screen instance
-TouchScreen touch(XP, YP, XM, YM, 300);
+TouchScreen touch(XP, YP, XM, YM, TS_RESISTANCE);
 
 // Temperature sensors
-MAX6675 sensor1(TEMP1_SCK, TEMP1_CS, TEMP1_SO);
-MAX6675 sensor2(TEMP2_SCK, TEMP2_CS, TEMP2_SO);
+MAX6675SPI sensor1(TEMP1_CS);
+MAX6675SPI sensor2(TEMP2_CS);
+
+// SSR drive for the heater, switched from a timer interrupt
+HeaterOutput heater(HEAT_PIN);
+
+// Fan PWM from Timer5
+FanOutput fan;
 
 // Component instances
 TempControl* tempControl = nullptr;
 PIDController* pidControl = nullptr;
 DisplayInterface* display = nullptr;
+TouchInput* touchInput = nullptr;
 ProfileManager* profiles = nullptr;
+RoastLogger* logger = nullptr;
+SDWriteQueue* sdQueue = nullptr;
 RoasterControl* roaster = nullptr;
+TaskScheduler* scheduler = nullptr;
+
+// Scan the touch panel and act on the events it produced
+void inputTask(void*) {
+    touchInput->poll();
+    
+    TouchEvent event;
+    while (touchInput->getEvent(&event)) {
+        switch (display->handleTouch(event)) {
+            case UI_START:
+                roaster->startRoast(false);
+                break;
+            case UI_STOP:
+                roaster->stopRoast();
+                break;
+            case UI_FAN_UP:
+                roaster->adjustFan(10);
+                break;
+            case UI_FAN_DOWN:
+                roaster->adjustFan(-10);
+                break;
+            case UI_HEAT_UP:
+                roaster->adjustHeat(5);
+                break;
+            case UI_HEAT_DOWN:
+                roaster->adjustHeat(-5);
+                break;
+            case UI_PROFILE:
+                roaster->toggleManualMode();
+                break;
+            case UI_SETTINGS:
+                if (roaster->isAutotuning()) {
+                    roaster->stopAutotune();
+                } else {
+                    roaster->startAutotune();
+                }
+                break;
+        }
+    }
+}
 
 void setup() {
     // Initialize serial for debugging
@@ -38,55 +82,29 @@ void setup() {
     // Initialize components in correct order
     tempControl = new TempControl(&sensor1, &sensor2);
     pidControl = new PIDController();
-    display = new DisplayInterface(&tft, &touch);
-    profiles = new ProfileManager();
+    display = new DisplayInterface(&tft);
+    touchInput = new TouchInput(&touch);
+    sdQueue = new SDWriteQueue();
+    profiles = new ProfileManager(sdQueue);
+    logger = new RoastLogger(sdQueue);
     
     // Create roaster control last since it depends on other components
-    roaster = new RoasterControl(tempControl, pidControl, display, profiles);
+    roaster = new RoasterControl(tempControl, pidControl, display, profiles, logger, sdQueue,
+                                 &heater, &fan);
     
     // Initialize roaster control system
     roaster->begin();
+    
+    // Everything runs as fixed-period tasks from here on
+    scheduler = new TaskScheduler();
+    roaster->registerTasks(scheduler);
+    scheduler->addTask(inputTask, nullptr, TOUCH_SAMPLE_INTERVAL, PRIORITY_INPUT);
+    
+    // Timing report over Serial when built with ROASTER_PROFILING
+    Profiler::begin(scheduler, roaster->getInterlock(), sdQueue);
 }
 
 void loop() {
-    // Main control loop
-    roaster->update();
-    
-    // Handle touch input if available
-    TSPoint p = touch.getPoint();
-    
-    // Restore pins that are shared between touch and display
-    pinMode(XM, OUTPUT);
-    pinMode(YP, OUTPUT);
-    
-    if (p.z > MINPRESSURE && p.z < MAXPRESSURE) {
-        int command = display->handleTouch();
-        
-        switch (command) {
-            case 1: // Start
-                roaster->startRoast(false);
-                break;
-            case 2: // Stop
-                roaster->stopRoast();
-                break;
-            case 3: // Fan Up
-                roaster->adjustFan(10);
-                break;
-            case 4: // Fan Down
-                roaster->adjustFan(-10);
-                break;
-            case 5: // Heat Up
-                roaster->adjustHeat(5);
-                break;
-            case 6: // Heat Down
-                roaster->adjustHeat(-5);
-                break;
-            case 7: // Profile Mode
-                roaster->toggleManualMode();
-                break;
-        }
-    }
-    
-    // Small delay to prevent overwhelming the system
-    delay(10);
-}
\ No newline at end of file
+    // Run whichever task is due
+    scheduler->run();
+}
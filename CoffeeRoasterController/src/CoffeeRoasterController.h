@@ -6,9 +6,7 @@
 #include <SD.h>
 #include <MCUFRIEND_kbv.h>
 #include <TouchScreen.h>
-#include <max6675.h>
 #include <Wire.h>
-#include <PID_v1.h>
 #include <Adafruit_GFX.h>
 #include <TouchScreen.h>
 #include <LiquidCrystal.h>
@@ -16,10 +14,22 @@
 
 // Include our component headers in correct dependency order
 #include "RoasterConfig.h"
+#include "MAX6675SPI.h"
+#include "HeaterOutput.h"
+#include "FanOutput.h"
+#include "TempChannel.h"
 #include "TempControl.h"
+#include "SafetyInterlock.h"
+#include "GainSchedule.h"
 #include "PIDController.h"
+#include "PIDAutotune.h"
+#include "TouchInput.h"
 #include "DisplayInterface.h"
+#include "SDWriteQueue.h"
 #include "ProfileManager.h"
+#include "RoastLogger.h"
+#include "TaskScheduler.h"
+#include "Profiler.h"
 #include "RoasterControl.h"
 
 #endif
\ No newline at end of file
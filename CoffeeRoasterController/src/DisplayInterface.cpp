@@ -2,30 +2,55 @@
 #include <string.h>
 #include <MCUFRIEND_kbv.h>  // Include the correct display library
 #include "TempControl.h"
+#include "Profiler.h"
 
 extern MCUFRIEND_kbv tft; // Reference the existing tft defined elsewhere
 
-// Constructor initializes the display and touchscreen pointers
-DisplayInterface::DisplayInterface(MCUFRIEND_kbv* display, TouchScreen* touchscreen) {
+// Left edge of the control column
+#define CONTROLS_X (GRAPH_WIDTH + 2 * MARGIN)
+
+// Main screen widgets
+static const Widget mainScreen[] PROGMEM = {
+    { CONTROLS_X,      30, 50, 25, UI_START,     WIDGET_IDLE_ONLY,  TFT_GREEN,  "START" },
+    { CONTROLS_X + 55, 30, 50, 25, UI_STOP,      WIDGET_ROAST_ONLY, TFT_RED,    "STOP" },
+    { CONTROLS_X,      65, 30, 25, UI_FAN_UP,    WIDGET_REPEAT,     TFT_BLUE,   "F+" },
+    { CONTROLS_X + 35, 65, 30, 25, UI_FAN_DOWN,  WIDGET_REPEAT,     TFT_BLUE,   "F-" },
+    { CONTROLS_X,     100, 30, 25, UI_HEAT_UP,   WIDGET_REPEAT,     TFT_RED,    "H+" },
+    { CONTROLS_X + 35,100, 30, 25, UI_HEAT_DOWN, WIDGET_REPEAT,     TFT_RED,    "H-" },
+    { CONTROLS_X,     135, 50, 25, UI_PROFILE,   0,                 TFT_PURPLE, "PROF" },
+    { CONTROLS_X + 55,135, 50, 25, UI_SETTINGS,  0,                 TFT_PURPLE, "SET" },
+};
+
+static_assert(sizeof(mainScreen) / sizeof(mainScreen[0]) <= 16, "dirty mask holds 16 widgets");
+
+// Constructor initializes the display pointer
+DisplayInterface::DisplayInterface(MCUFRIEND_kbv* display) {
     tft = display;
-    touch = touchscreen;
     isRoasting = false;
     historyIndex = 0;
+    graphDirty = true;
+    backgroundPending = false;
+    backgroundColor = TFT_BLACK;
+    warning = nullptr;
+    warningDirty = false;
+
+    dataPending = false;
+    framePhase = FRAME_DONE;
+    frameStep = 0;
+    repainting = false;
+    lastFrameTime = 0;
+    framesDropped = 0;
+    worstFrameTime = 0;
 
     graphX = MARGIN;                                                                                                                         
     graphY = MARGIN;
-    controlsX = GRAPH_WIDTH + (2 * MARGIN);
+    controlsX = CONTROLS_X;
     controlsY = MARGIN;
 
-    // Initialize buttons
-    startButton = Button(controlsX, 30, 50, 25, false, "START");
-    stopButton = Button(controlsX + 55, 30, 50, 25, false, "STOP");
-    fanUpButton = Button(controlsX, 65, 30, 25, false, "F+");
-    fanDownButton = Button(controlsX + 35, 65, 30, 25, false, "F-");
-    heatUpButton = Button(controlsX, 100, 30, 25, false, "H+");
-    heatDownButton = Button(controlsX + 35, 100, 30, 25, false, "H-");
-    profileButton = Button(controlsX, 135, 50, 25, false, "PROF");
-    settingsButton = Button(controlsX + 55, 135, 50, 25, false, "SET");
+    // Start on the main screen with every widget to be drawn
+    widgets = mainScreen;
+    widgetCount = sizeof(mainScreen) / sizeof(mainScreen[0]);
+    dirtyWidgets = (1 << widgetCount) - 1;
 
     // Initialize history arrays
     memset(tempHistory, 0, sizeof(tempHistory));
@@ -40,190 +65,357 @@ void DisplayInterface::begin() {
     tft->fillScreen(TFT_BLACK);  // Clear the screen
 
     // Draw initial layout
-    drawButtons();
+    drawDirtyWidgets();
     drawGraph();
     drawStatus();
 }
 
 // Update the display with new temperature, rate of rise, fan, and heat values
-void DisplayInterface::update(float temp, float ror, uint8_t fan, uint8_t heat) {
+// Only records the values; drawing happens in refresh()
+void DisplayInterface::update(temp_t temp, temp_t ror, uint8_t fan, uint8_t heat) {
     currentTemp = temp;
     rorValue = ror;
     fanSpeed = fan;
     heatPower = heat;
+    dataPending = true;
+}
 
-    // Update history arrays
-    tempHistory[historyIndex] = temp;
-    rorHistory[historyIndex] = ror;
-    historyIndex = (historyIndex + 1) % GRAPH_WIDTH;
+// Draw the display at UI_REFRESH_INTERVAL without holding up the caller
+// A frame is split into steps of at most UI_STEP_US; once another step
+// might not fit in UI_FRAME_BUDGET_US, the rest wait for the next pass
+void DisplayInterface::refresh() {
+    unsigned long now = millis();
+    bool frameDue = now - lastFrameTime >= UI_REFRESH_INTERVAL;
+
+    if (framePhase == FRAME_DONE) {
+        if (!frameDue || (!dataPending && !graphDirty && !dirtyWidgets && !backgroundPending &&
+                          !warningDirty)) {
+            return;
+        }
+        lastFrameTime = now;
+        framePhase = FRAME_BACKGROUND;
+        frameStep = 0;
+    } else if (frameDue) {
+        // Still finishing the previous frame; skip this one
+        framesDropped++;
+        lastFrameTime = now;
+    }
 
-    // Refresh display
-    drawGraph();
-    drawStatus();
+    unsigned long start = micros();
+    while (framePhase != FRAME_DONE) {
+        if (drawFramePhase(framePhase, frameStep)) {
+            framePhase++;
+            frameStep = 0;
+        } else {
+            frameStep++;
+        }
+        if (micros() - start > UI_FRAME_BUDGET_US - UI_STEP_US) {
+            break;
+        }
+    }
+
+    unsigned long elapsed = micros() - start;
+    if (elapsed > worstFrameTime) {
+        worstFrameTime = elapsed;
+    }
 }
 
-// Handle touch input from the touchscreen
-int DisplayInterface::handleTouch() {
-    TSPoint p = touch->getPoint();
-    
-    // Restore pins that are shared between touch and display
-    pinMode(XM, OUTPUT);
-    pinMode(YP, OUTPUT);
+// Draw one step of a frame
+// A request arriving while a fill or repaint is under way is taken up
+// by the next frame
+// @return true once the phase is complete
+bool DisplayInterface::drawFramePhase(uint8_t phase, uint8_t step) {
+    if (phase == FRAME_BACKGROUND) {
+        if (step == 0) {
+            repainting = backgroundPending;
+            backgroundPending = false;
+        }
+        if (!repainting) {
+            return true;
+        }
+        int y = step * UI_FILL_ROWS;
+        tft->fillRect(0, y, tft->width(), UI_FILL_ROWS, backgroundColor);
+        if (y + UI_FILL_ROWS < tft->height()) {
+            return false;
+        }
+        // The fill wiped the warning text, put it back in this frame
+        warningDirty |= warning != nullptr;
+        return true;
+    }
+    if (phase == FRAME_WIDGETS) {
+        drawDirtyWidgets();
+        return true;
+    }
+    if (phase == FRAME_WARNING) {
+        if (warningDirty) {
+            drawWarning();
+            warningDirty = false;
+        }
+        return true;
+    }
+    if (phase != FRAME_GRAPH) {
+        drawStatusLine(phase);
+        return true;
+    }
 
-    // Check if touch pressure is within range
-    if (p.z < MINPRESSURE || p.z > MAXPRESSURE) {
-        return 0;
+    if (step == 0) {
+        repainting = graphDirty;
+        graphDirty = false;
+
+        // Add the latest sample to the graph, only the new column unless
+        // the screen was wiped
+        if (dataPending) {
+            int col = historyIndex;
+            tempHistory[col] = currentTemp;
+            rorHistory[col] = rorValue;
+            historyIndex = (historyIndex + 1) % GRAPH_WIDTH;
+            dataPending = false;
+            if (!repainting) {
+                drawGraphSample(col);
+            }
+        }
+    }
+    if (!repainting) {
+        return true;
     }
+    if (!drawGraphColumns(step * GRAPH_REPAINT_COLUMNS)) {
+        return false;
+    }
+    warningDirty |= warning != nullptr;  // The graph overlaps the warning area
+    return true;
+}
 
-    // Map touch coordinates to screen coordinates
-    int16_t x = map(p.x, TS_LEFT, TS_RT, 0, tft->width());
-    int16_t y = map(p.y, TS_TOP, TS_BOT, 0, tft->height());
+// Map a debounced touch event to the action of the widget under it
+uint8_t DisplayInterface::handleTouch(const TouchEvent& event) {
+    if (event.type == TOUCH_RELEASE) {
+        return UI_NONE;
+    }
+
+    int8_t index = hitTest(event.x, event.y);
+    if (index < 0) {
+        return UI_NONE;
+    }
 
-    // Check which button was pressed
-    Button* pressed = checkButtonPress(x, y);
-    if (pressed) {
-        if (pressed == &startButton) return 1;
-        if (pressed == &stopButton) return 2;
-        if (pressed == &fanUpButton) return 3;
-        if (pressed == &fanDownButton) return 4;
-        if (pressed == &heatUpButton) return 5;
-        if (pressed == &heatDownButton) return 6;
-        if (pressed == &profileButton) return 7;
-        if (pressed == &settingsButton) return 8;
+    // Holding repeats only widgets that ask for it
+    uint8_t flags = pgm_read_byte(&widgets[index].flags);
+    if (event.type == TOUCH_REPEAT && !(flags & WIDGET_REPEAT)) {
+        return UI_NONE;
     }
+    return pgm_read_byte(&widgets[index].action);
+}
 
-    return 0;
+// Map a temperature to a screen row inside the graph
+int DisplayInterface::tempToY(temp_t temp) {
+    return map(temp, 0, TEMP_C(MAX_TEMP), GRAPH_HEIGHT + graphY, graphY);
 }
 
-// Draw the graph (temperature curve) on the screen
+// Draw the whole graph (temperature curve) on the screen
 void DisplayInterface::drawGraph() {
+    for (int first = 0; !drawGraphColumns(first); first += GRAPH_REPAINT_COLUMNS) {
+    }
+    graphDirty = false;
+}
+
+// Repaint GRAPH_REPAINT_COLUMNS graph columns, a slice of a full repaint
+// The graph is a sweep display: sample i lives in column i and the
+// column at historyIndex is the blank gap in front of the newest sample
+// @return true once the last column is done
+bool DisplayInterface::drawGraphColumns(int first) {
+    TIME_SECTION(SECTION_DRAW_GRAPH);
+
+    int last = min(first + GRAPH_REPAINT_COLUMNS, GRAPH_WIDTH);
+
     // Draw graph background
-    tft->fillRect(graphX, graphY, GRAPH_WIDTH, GRAPH_HEIGHT, TFT_BLACK);
+    tft->fillRect(graphX + first, graphY, last - first, GRAPH_HEIGHT, TFT_BLACK);
 
     // Draw grid
-    for (int i = 0; i < GRAPH_WIDTH; i += 20) {
+    for (int i = (first + GRAPH_GRID - 1) / GRAPH_GRID * GRAPH_GRID; i < last; i += GRAPH_GRID) {
         tft->drawFastVLine(graphX + i, graphY, GRAPH_HEIGHT, TFT_DARKGREY);
     }
-    for (int i = 0; i < GRAPH_HEIGHT; i += 20) {
-        tft->drawFastHLine(graphX, graphY + i, GRAPH_WIDTH, TFT_DARKGREY);
+    for (int i = 0; i < GRAPH_HEIGHT; i += GRAPH_GRID) {
+        tft->drawFastHLine(graphX + first, graphY + i, last - first, TFT_DARKGREY);
     }
 
-    // Draw temperature curve
-    for (int i = 1; i < GRAPH_WIDTH; i++) {
-        int idx = (historyIndex + i) % GRAPH_WIDTH;
-        int prevIdx = (historyIndex + i - 1) % GRAPH_WIDTH;
-
-        if (tempHistory[idx] > 0 && tempHistory[prevIdx] > 0) {
-            int y1 = map(tempHistory[prevIdx], 0, MAX_TEMP, GRAPH_HEIGHT + graphY, graphY);
-            int y2 = map(tempHistory[idx], 0, MAX_TEMP, GRAPH_HEIGHT + graphY, graphY);
-            tft->drawLine(graphX + i - 1, y1, graphX + i, y2, TFT_YELLOW);
+    // Draw the curve into these columns, skipping the segments touching the gap
+    for (int i = max(first, 1); i < last; i++) {
+        if (i == historyIndex || i - 1 == historyIndex) {
+            continue;
+        }
+        if (tempHistory[i] > 0 && tempHistory[i - 1] > 0) {
+            tft->drawLine(graphX + i - 1, tempToY(tempHistory[i - 1]),
+                          graphX + i, tempToY(tempHistory[i]), TFT_YELLOW);
         }
     }
+
+    return last == GRAPH_WIDTH;
+}
+
+// Draw only the segment ending at a new sample and open the gap ahead of it
+// Costs two column erases and one short line regardless of history length
+void DisplayInterface::drawGraphSample(int col) {
+    TIME_SECTION(SECTION_DRAW_GRAPH);
+
+    if (col > 0 && tempHistory[col] > 0 && tempHistory[col - 1] > 0) {
+        tft->drawLine(graphX + col - 1, tempToY(tempHistory[col - 1]),
+                      graphX + col, tempToY(tempHistory[col]), TFT_YELLOW);
+    }
+    clearGraphColumn((col + 1) % GRAPH_WIDTH);
 }
 
-// Draw buttons on the screen
-void DisplayInterface::drawButtons() {
+// Erase one graph column and restore the grid pixels under it
+void DisplayInterface::clearGraphColumn(int col) {
+    int x = graphX + col;
+    if (col % GRAPH_GRID == 0) {
+        tft->drawFastVLine(x, graphY, GRAPH_HEIGHT, TFT_DARKGREY);
+        return;
+    }
+    tft->drawFastVLine(x, graphY, GRAPH_HEIGHT, TFT_BLACK);
+    for (int i = 0; i < GRAPH_HEIGHT; i += GRAPH_GRID) {
+        tft->drawPixel(x, graphY + i, TFT_DARKGREY);
+    }
+}
+
+// Draw one widget from the screen table
+void DisplayInterface::drawWidget(uint8_t index) {
+    Widget widget;
+    memcpy_P(&widget, &widgets[index], sizeof(widget));
+
+    // State-dependent widgets are greyed out when they do nothing
+    bool active = !((widget.flags & WIDGET_IDLE_ONLY) && isRoasting)
+               && !((widget.flags & WIDGET_ROAST_ONLY) && !isRoasting);
+    uint16_t color = active ? widget.color : TFT_DARKGREY;
+
+    tft->fillRoundRect(widget.x, widget.y, widget.w, widget.h, 3, color);
+    tft->drawRoundRect(widget.x, widget.y, widget.w, widget.h, 3, TFT_WHITE);
+
+    // Center text
+    int16_t x1, y1;
+    uint16_t w, h;
     tft->setTextSize(1);
+    tft->getTextBounds(widget.label, 0, 0, &x1, &y1, &w, &h);
+    tft->setCursor(widget.x + (widget.w - w) / 2, widget.y + (widget.h - h) / 2 + 4);
+    tft->setTextColor(TFT_WHITE);
+    tft->print(widget.label);
+}
+
+// Redraw the widgets whose state changed
+void DisplayInterface::drawDirtyWidgets() {
+    TIME_SECTION(SECTION_DRAW_WIDGETS);
 
-    // Function to draw individual button
-    auto drawButton = [this](Button& btn, uint16_t color) {
-        tft->fillRoundRect(btn.x, btn.y, btn.w, btn.h, 3, color);
-        tft->drawRoundRect(btn.x, btn.y, btn.w, btn.h, 3, TFT_WHITE);
-
-        // Center text
-        int16_t x1, y1;
-        uint16_t w, h;
-        tft->getTextBounds(btn.label, 0, 0, &x1, &y1, &w, &h);
-        int textX = btn.x + (btn.w - w) / 2;
-        int textY = btn.y + (btn.h - h) / 2 + 4;
-
-        tft->setCursor(textX, textY);
-        tft->setTextColor(TFT_WHITE);
-        tft->print(btn.label);
-    };
-
-    // Draw all buttons
-    drawButton(startButton, isRoasting ? TFT_DARKGREY : TFT_GREEN);
-    drawButton(stopButton, isRoasting ? TFT_RED : TFT_DARKGREY);
-    drawButton(fanUpButton, TFT_BLUE);
-    drawButton(fanDownButton, TFT_BLUE);
-    drawButton(heatUpButton, TFT_RED);
-    drawButton(heatDownButton, TFT_RED);
-    drawButton(profileButton, TFT_PURPLE);
-    drawButton(settingsButton, TFT_PURPLE);
+    for (uint8_t i = 0; i < widgetCount; i++) {
+        if (dirtyWidgets & (1 << i)) {
+            drawWidget(i);
+        }
+    }
+    dirtyWidgets = 0;
+}
+
+// Widgets carrying any of the given flags
+uint16_t DisplayInterface::widgetStateMask(uint8_t flags) {
+    uint16_t mask = 0;
+    for (uint8_t i = 0; i < widgetCount; i++) {
+        if (pgm_read_byte(&widgets[i].flags) & flags) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+// Track roasting state for widget coloring
+void DisplayInterface::setRoasting(bool roasting) {
+    if (roasting != isRoasting) {
+        isRoasting = roasting;
+        dirtyWidgets |= widgetStateMask(WIDGET_IDLE_ONLY | WIDGET_ROAST_ONLY);
+    }
 }
 
 // Draw the status information on the screen (temperature, fan speed, etc.)
 void DisplayInterface::drawStatus() {
-    // Clear status area
-    tft->fillRect(controlsX, MARGIN, SCREEN_WIDTH - controlsX - MARGIN, 25, TFT_BLACK);
+    drawStatusLine(FRAME_STATUS_TEMP);
+    drawStatusLine(FRAME_STATUS_ROR);
+    drawStatusLine(FRAME_STATUS_FAN);
+}
 
-    // Draw current values
-    tft->setTextSize(1);
-    tft->setTextColor(TFT_WHITE);
+// Draw a single line of the status area
+void DisplayInterface::drawStatusLine(uint8_t phase) {
+    TIME_SECTION(SECTION_DRAW_STATUS);
 
-    char buffer[30];
+    int line = phase - FRAME_STATUS_TEMP;
+    int y = MARGIN + line * 10;
 
-    // Temperature
-    sprintf(buffer, "Temp: %.1fC", currentTemp);
-    tft->setCursor(controlsX, MARGIN);
-    tft->print(buffer);
+    // Clear this line only
+    tft->fillRect(controlsX, y, SCREEN_WIDTH - controlsX - MARGIN, 10, TFT_BLACK);
 
-    // RoR
-    sprintf(buffer, "RoR: %.1fC/min", rorValue * 60);
-    tft->setCursor(controlsX, MARGIN + 10);
-    tft->print(buffer);
+    tft->setTextSize(1);
+    tft->setTextColor(TFT_WHITE);
 
-    // Fan and Heat
-    sprintf(buffer, "Fan: %d%%", map(fanSpeed, 0, 255, 0, 100));
-    tft->setCursor(controlsX + 55, MARGIN + 20);
+    char buffer[30];
+    char value[8];
+
+    switch (phase) {
+        case FRAME_STATUS_TEMP:
+            // Temperature
+            sprintf(buffer, "Temp: %sC", formatTemp(value, currentTemp));
+            tft->setCursor(controlsX, y);
+            break;
+
+        case FRAME_STATUS_ROR:
+            // RoR
+            sprintf(buffer, "RoR: %sC/min", formatTemp(value, rorValue));
+            tft->setCursor(controlsX, y);
+            break;
+
+        default:
+            // Fan and Heat
+            sprintf(buffer, "Fan: %d%%", (int)map(fanSpeed, 0, 255, 0, 100));
+            tft->setCursor(controlsX + 55, y);
+            break;
+    }
     tft->print(buffer);
 }
 
-// Show warning message
+// Show warning message, drawn by the next frame
 void DisplayInterface::showWarning(const char* message) {
-    tft->setTextColor(TFT_RED);
-    tft->setTextSize(2);
-    tft->setCursor(10, 10);
-    tft->print(message);
+    warning = message;
+    warningDirty = true;
 }
 
-// Clear warning message
+// Clear warning message, erased by the next frame
 void DisplayInterface::clearWarning() {
+    warning = nullptr;
+    warningDirty = true;
+}
+
+// Draw the warning area, blank if no message is showing
+void DisplayInterface::drawWarning() {
     tft->fillRect(0, 0, tft->width(), 20, TFT_BLACK);  // Clear warning area
+    if (warning == nullptr) {
+        return;
+    }
+    tft->setTextColor(TFT_RED);
+    tft->setTextSize(2);
+    tft->setCursor(10, 10);
+    tft->print(warning);
 }
 
 // Set stage color
 void DisplayInterface::setStageColor(uint16_t color) {
-    tft->fillScreen(color);  // Set the entire screen to the given color
+    // The fill is drawn by the next frame, not by the caller
+    backgroundColor = color;
+    backgroundPending = true;
+    graphDirty = true;       // Graph will be wiped, repaint it in the same frame
+    dirtyWidgets = (1 << widgetCount) - 1;
 }
 
-// Check button press
-Button* DisplayInterface::checkButtonPress(int16_t x, int16_t y) {
-    // Check if touch is inside the button area
-    if (x >= startButton.x && x <= startButton.x + startButton.w && y >= startButton.y && y <= startButton.y + startButton.h) {
-        return &startButton;
-    }
-    if (x >= stopButton.x && x <= stopButton.x + stopButton.w && y >= stopButton.y && y <= stopButton.y + stopButton.h) {
-        return &stopButton;
-    }
-    if (x >= fanUpButton.x && x <= fanUpButton.x + fanUpButton.w && y >= fanUpButton.y && y <= fanUpButton.y + fanUpButton.h) {
-        return &fanUpButton;
-    }
-    if (x >= fanDownButton.x && x <= fanDownButton.x + fanDownButton.w && y >= fanDownButton.y && y <= fanDownButton.y + fanDownButton.h) {
-        return &fanDownButton;
-    }
-    if (x >= heatUpButton.x && x <= heatUpButton.x + heatUpButton.w && y >= heatUpButton.y && y <= heatUpButton.y + heatUpButton.h) {
-        return &heatUpButton;
-    }
-    if (x >= heatDownButton.x && x <= heatDownButton.x + heatDownButton.w && y >= heatDownButton.y && y <= heatDownButton.y + heatDownButton.h) {
-        return &heatDownButton;
-    }
-    if (x >= profileButton.x && x <= profileButton.x + profileButton.w && y >= profileButton.y && y <= profileButton.y + profileButton.h) {
-        return &profileButton;
-    }
-    if (x >= settingsButton.x && x <= settingsButton.x + settingsButton.w && y >= settingsButton.y && y <= settingsButton.y + settingsButton.h) {
-        return &settingsButton;
+// Find the widget under a point with one pass over the table
+int8_t DisplayInterface::hitTest(int16_t x, int16_t y) {
+    for (uint8_t i = 0; i < widgetCount; i++) {
+        int16_t wx = pgm_read_word(&widgets[i].x);
+        int16_t wy = pgm_read_byte(&widgets[i].y);
+        if (x >= wx && x < wx + pgm_read_byte(&widgets[i].w)
+            && y >= wy && y < wy + pgm_read_byte(&widgets[i].h)) {
+            return i;
+        }
     }
-    return nullptr;
-}
\ No newline at end of file
+    return -1;
+}
@@ -3,85 +3,128 @@
 
 #include <stdint.h>
 #include <MCUFRIEND_kbv.h>
-#include <TouchScreen.h>
 #include "RoasterConfig.h"
+#include "TouchInput.h"
 #include <LiquidCrystal.h>
 
-// Button structure definition
-struct Button {
-    int x;
-    int y;
-    int w;
-    int h;
-    bool pressed;
-    char label[15];
-    
-    Button() : x(0), y(0), w(0), h(0), pressed(false) {
-        label[0] = '\0';
-    }
-    
-    Button(int _x, int _y, int _w, int _h, bool _pressed, const char* _label) 
-        : x(_x), y(_y), w(_w), h(_h), pressed(_pressed) {
-        strncpy(label, _label, 14);
-        label[14] = '\0';
-    }
+// Phases of one display frame, drawn in order within the frame budget
+// Filling the screen and repainting the graph take several steps each
+enum FramePhase {
+    FRAME_BACKGROUND,
+    FRAME_GRAPH,
+    FRAME_STATUS_TEMP,
+    FRAME_STATUS_ROR,
+    FRAME_STATUS_FAN,
+    FRAME_WIDGETS,
+    FRAME_WARNING,
+    FRAME_DONE
+};
+
+// Commands produced by touching a widget
+enum UiAction {
+    UI_NONE,
+    UI_START,
+    UI_STOP,
+    UI_FAN_UP,
+    UI_FAN_DOWN,
+    UI_HEAT_UP,
+    UI_HEAT_DOWN,
+    UI_PROFILE,
+    UI_SETTINGS
+};
+
+// Widget flags
+#define WIDGET_REPEAT       0x01    // Holding the widget repeats its action
+#define WIDGET_IDLE_ONLY    0x02    // Greyed out while roasting
+#define WIDGET_ROAST_ONLY   0x04    // Greyed out while idle
+#define WIDGET_LABEL_LENGTH 6
+
+// One touchable widget; screens are constant tables of these in PROGMEM
+struct Widget {
+    uint16_t x;
+    uint8_t y;
+    uint8_t w;
+    uint8_t h;
+    uint8_t action;                     // UiAction
+    uint8_t flags;                      // WIDGET_*
+    uint16_t color;                     // Fill color when active
+    char label[WIDGET_LABEL_LENGTH];
 };
 
 class DisplayInterface {
     private:
         MCUFRIEND_kbv* tft;         // Pointer to TFT display
-        TouchScreen* touch;         // Pointer to touchscreen
 
         // Screen areas (for UI layout)
         int graphX, graphY;
         int controlsX, controlsY;
 
-        // Touch pressure thresholds
-        const int MINPRESSURE = 200;
-        const int MAXPRESSURE = 1000;
-
-        // Button objects for the display
-        Button startButton;
-        Button stopButton;
-        Button fanUpButton;
-        Button fanDownButton;
-        Button heatUpButton;
-        Button heatDownButton;
-        Button profileButton;
-        Button settingsButton;
+        // Widgets of the current screen (PROGMEM table)
+        const Widget* widgets;
+        uint8_t widgetCount;
+        uint16_t dirtyWidgets;      // One bit per widget needing a redraw
 
         // Current values to display
-        float currentTemp;
-        float targetTemp;
-        float rorValue;
+        temp_t currentTemp;
+        temp_t targetTemp;
+        temp_t rorValue;            // Rate of rise in centi-degrees per minute
         uint8_t fanSpeed;
         uint8_t heatPower;
         bool isRoasting;
 
-        // Graph data arrays
-        float tempHistory[GRAPH_WIDTH];
-        float rorHistory[GRAPH_WIDTH];
-        int historyIndex;
+        // Graph data arrays, indexed by graph column
+        temp_t tempHistory[GRAPH_WIDTH];
+        temp_t rorHistory[GRAPH_WIDTH];
+        int historyIndex;           // Next column to be written
+        bool graphDirty;            // Graph needs a full repaint
+        bool backgroundPending;     // Screen fill requested by setStageColor
+        uint16_t backgroundColor;
+        const char* warning;        // Message showing in the warning area, nullptr if none
+        bool warningDirty;          // Warning area needs a redraw
+
+        // Refresh scheduling
+        bool dataPending;           // New values since the last frame
+        uint8_t framePhase;         // Next phase of the frame being drawn
+        uint8_t frameStep;          // Next step of that phase
+        bool repainting;            // The phase is part way through a fill or graph repaint
+        unsigned long lastFrameTime;    // millis() when the current frame started
+        unsigned long framesDropped;    // Frames skipped because drawing fell behind
+        unsigned long worstFrameTime;   // Longest single refresh pass in us
 
         // Internal helper functions
         void drawGraph();
-        void drawButtons();
+        bool drawGraphColumns(int first);
+        void drawGraphSample(int col);
+        void drawWarning();
+        void clearGraphColumn(int col);
+        int tempToY(temp_t temp);
+        void drawWidget(uint8_t index);
+        void drawDirtyWidgets();
+        uint16_t widgetStateMask(uint8_t flags); // Widgets whose look depends on these flags
         void drawStatus();
+        void drawStatusLine(uint8_t phase);
+        bool drawFramePhase(uint8_t phase, uint8_t step);
         
-        // Check for button press
-        Button* checkButtonPress(int16_t x, int16_t y);
+        // Find the widget under a point, -1 if none
+        int8_t hitTest(int16_t x, int16_t y);
 
     public:
-        // Constructor, accepts pointers to the TFT display and touchscreen
-        DisplayInterface(MCUFRIEND_kbv* display, TouchScreen* touchscreen);
+        // Constructor, accepts a pointer to the TFT display
+        DisplayInterface(MCUFRIEND_kbv* display);
 
         // Public methods
         void begin();               // Initialize display
-        void update(float temp, float ror, uint8_t fan, uint8_t heat); // Update display values
-        int handleTouch();          // Handle touch events
+        void update(temp_t temp, temp_t ror, uint8_t fan, uint8_t heat); // Update display values
+        void refresh();             // Draw pending changes, rate limited and time budgeted
+        unsigned long getFramesDropped() { return framesDropped; }  // Frames skipped so far
+        unsigned long getWorstFrameTime() { return worstFrameTime; } // Longest refresh pass in us
+        uint8_t handleTouch(const TouchEvent& event); // Map a touch event to a UiAction
+        void setRoasting(bool roasting); // Redraw state-dependent widgets when this changes
         void setStageColor(uint16_t color); // Change the color of the stage
+        void redrawGraph() { graphDirty = true; } // Repaint the whole graph in the next frame
         void showWarning(const char* message); // Show a warning message on the display
         void clearWarning();        // Clear any warning message on the display
+        const char* getWarning() { return warning; } // Message showing, nullptr if none
 };
 
 #endif
\ No newline at end of file
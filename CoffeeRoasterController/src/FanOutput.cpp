@@ -0,0 +1,133 @@
+#include "FanOutput.h"
+
+#ifdef __AVR__
+// Timer5 fast PWM, mode 14 (TOP in ICR5), no prescaler
+#define FAN_TIMER_TOP (F_CPU / FAN_PWM_FREQUENCY - 1)
+static_assert(FAN_TIMER_TOP <= 0xFFFF, "PWM period must fit Timer5");
+static_assert(FAN_PIN == 46, "fan PWM comes from OC5A");
+#endif
+
+// Longest gap credited to the slew limit, so a late update cannot jump
+#define FAN_MAX_STEP_MS 1000
+
+FanOutput::FanOutput() {
+    target = 0;
+    output = 0;
+    slewRate = FAN_SLEW_RATE;
+    minDuty = FAN_MIN_DUTY;
+    lastUpdate = 0;
+    slewCredit = 0;
+    held = false;
+}
+
+void FanOutput::begin() {
+    pinMode(FAN_PIN, OUTPUT);
+    digitalWrite(FAN_PIN, LOW);
+    
+#ifdef __AVR__
+    // Output compare stays disconnected until the first nonzero duty
+    TCCR5A = _BV(WGM51);
+    TCCR5B = _BV(WGM53) | _BV(WGM52) | _BV(CS50);
+    ICR5 = FAN_TIMER_TOP;
+    OCR5A = 0;
+#endif
+    
+    target = 0;
+    apply(0);
+    lastUpdate = millis();
+}
+
+/**
+ * Disconnect the pin at zero, since fast PWM still gives a one-clock
+ * pulse every period with OCR5A at 0
+ */
+void FanOutput::apply(uint8_t duty) {
+    output = duty;
+#ifdef __AVR__
+    if (duty == 0) {
+        TCCR5A &= ~_BV(COM5A1);
+        digitalWrite(FAN_PIN, LOW);
+    } else {
+        OCR5A = (uint32_t)duty * FAN_TIMER_TOP / PWM_MAX;
+        TCCR5A |= _BV(COM5A1);
+    }
+#else
+    analogWrite(FAN_PIN, duty);
+#endif
+}
+
+void FanOutput::setSpeed(uint8_t speed) {
+    if (speed > 0 && speed < minDuty) {
+        speed = minDuty;
+    }
+    target = speed;
+}
+
+void FanOutput::force(uint8_t speed) {
+    held = true;
+    apply(speed);
+}
+
+void FanOutput::release() {
+    held = false;
+}
+
+void FanOutput::setSlewRate(uint16_t countsPerSecond) {
+    slewRate = countsPerSecond;
+}
+
+void FanOutput::setMinDuty(uint8_t duty) {
+    minDuty = duty;
+}
+
+void FanOutput::update() {
+    unsigned long now = millis();
+    unsigned long elapsed = min(now - lastUpdate, (unsigned long)FAN_MAX_STEP_MS);
+    lastUpdate = now;
+    
+    if (held || output == target) {
+        slewCredit = 0;
+        return;
+    }
+    if (slewRate == 0) {
+        applyUnlessHeld(target);
+        return;
+    }
+    
+    // Whole counts earned since the last step; the rest carries over
+    uint32_t credit = slewCredit + (uint32_t)elapsed * slewRate;
+    uint32_t step = credit / 1000;
+    slewCredit = credit % 1000;
+    if (step > PWM_MAX) {
+        step = PWM_MAX;
+        slewCredit = 0;
+    }
+    if (step == 0) {
+        return;
+    }
+    
+    int16_t next;
+    if (target > output) {
+        next = min((int16_t)(output + step), (int16_t)target);
+    } else {
+        next = max((int16_t)(output - step), (int16_t)target);
+    }
+    
+    // Skip the band where the fan stalls
+    if (next > 0 && next < minDuty) {
+        next = target > output ? minDuty : 0;
+    }
+    applyUnlessHeld(next);
+}
+
+/**
+ * A force() from an interrupt between the check in update() and here
+ * must not be overwritten with a ramp step
+ */
+void FanOutput::applyUnlessHeld(uint8_t duty) {
+    noInterrupts();
+    if (!held) {
+        apply(duty);
+    }
+    interrupts();
+}
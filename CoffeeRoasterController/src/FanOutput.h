@@ -0,0 +1,94 @@
+#ifndef FAN_OUTPUT_H
+#define FAN_OUTPUT_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+
+/**
+ * @class FanOutput
+ * @brief Slew-limited hardware PWM for the DC fan
+ * 
+ * Timer5 runs in fast PWM mode with its period in ICR5, giving
+ * FAN_PWM_FREQUENCY on OC5A (FAN_PIN, 46) with 640 steps at 25 kHz, so
+ * the fan neither whines nor pulses the way the 490 Hz analogWrite()
+ * PWM would. Pins 44 and 45 share the timer but stay plain digital pins.
+ * 
+ * setSpeed() only sets a target. update() moves the output towards it
+ * at no more than the slew rate, and never leaves it between zero and
+ * FAN_MIN_DUTY, where the fan would stall: starting jumps straight to
+ * the minimum and stopping drops from it to zero.
+ */
+class FanOutput {
+    private:
+        uint8_t target;             // Requested speed (0-255)
+        uint8_t output;             // Speed applied to the timer
+        uint16_t slewRate;          // Counts per second, 0 for unlimited
+        uint8_t minDuty;            // Lowest nonzero output
+        unsigned long lastUpdate;   // millis() of the last update()
+        uint16_t slewCredit;        // Unspent slew, counts x 1000
+        volatile bool held;         // Output forced by force()
+        
+        /**
+         * @brief Load a duty into the timer compare register
+         */
+        void apply(uint8_t duty);
+        
+        /**
+         * @brief Apply a ramp step unless the output is being forced
+         */
+        void applyUnlessHeld(uint8_t duty);
+        
+    public:
+        FanOutput();
+        
+        /**
+         * @brief Start the timer with the fan off
+         */
+        void begin();
+        
+        /**
+         * @brief Set the speed to ramp to
+         * @param speed 0 (off) to PWM_MAX; nonzero values below the
+         * minimum are raised to it
+         */
+        void setSpeed(uint8_t speed);
+        
+        /**
+         * @brief Step the output towards the target; call every FAN_RAMP_PERIOD
+         */
+        void update();
+        
+        /**
+         * @brief Drive a speed at once and hold it until release()
+         * Bypasses the slew limit; safe to call from an interrupt
+         */
+        void force(uint8_t speed);
+        
+        /**
+         * @brief Return to ramping towards the target set by setSpeed()
+         */
+        void release();
+        
+        /**
+         * @brief Change the slew limit
+         * @param countsPerSecond Largest output change per second, 0 for none
+         */
+        void setSlewRate(uint16_t countsPerSecond);
+        
+        /**
+         * @brief Change the lowest nonzero output
+         */
+        void setMinDuty(uint8_t duty);
+        
+        /**
+         * @brief Get the requested speed
+         */
+        uint8_t getTarget() { return target; }
+        
+        /**
+         * @brief Get the speed being driven now
+         */
+        uint8_t getOutput() { return output; }
+};
+
+#endif // FAN_OUTPUT_H
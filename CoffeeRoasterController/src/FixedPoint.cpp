@@ -0,0 +1,59 @@
+#include "FixedPoint.h"
+
+/**
+ * Format a temperature with one decimal place
+ * Integer only, so it works without the AVR printf float support
+ */
+char* formatTemp(char* buffer, temp_t t) {
+    if (t == TEMP_INVALID) {
+        buffer[0] = buffer[1] = buffer[2] = '-';
+        buffer[3] = '\0';
+        return buffer;
+    }
+
+    // Round to tenths; 32-bit so the rounding step cannot overflow
+    int32_t tenths = ((int32_t)t + (t < 0 ? -5 : 5)) / 10;
+    char* p = buffer;
+    if (tenths < 0) {
+        *p++ = '-';
+        tenths = -tenths;
+    }
+
+    // Whole degrees, most significant digit first
+    char digits[5];
+    uint8_t count = 0;
+    uint16_t whole = tenths / 10;
+    do {
+        digits[count++] = '0' + whole % 10;
+        whole /= 10;
+    } while (whole > 0);
+    while (count > 0) {
+        *p++ = digits[--count];
+    }
+
+    *p++ = '.';
+    *p++ = '0' + tenths % 10;
+    *p = '\0';
+    return buffer;
+}
+
+//===========================================
+// Compile-time accuracy checks
+//===========================================
+// Conversions must be exact on the MAX6675 grid and round correctly
+// everywhere else; these fail the build if the helpers regress.
+
+static_assert(TEMP_C(290) == 29000, "whole degrees scale by 100");
+static_assert(tempFromQuarterDegrees(1) == 25, "0.25°C is 25 centi-degrees");
+static_assert(tempFromQuarterDegrees(4 * 290 + 3) == 29075, "sensor grid is exact");
+static_assert(tempFromQuarterDegrees(4095) == TEMP_LIMIT, "MAX6675 full scale saturates");
+static_assert(tempFromFloat(21.37f) == 2137, "float conversion rounds to nearest");
+static_assert(tempFromFloat(-0.004f) == 0, "small negatives round to zero");
+static_assert(tempFromFloat(-12.345f) == -1235, "negatives round away from zero");
+static_assert(tempFromFloat(1000.0f) == TEMP_LIMIT, "out of range saturates");
+static_assert(tempToFloat(TEMP_C(200)) == 200.0f, "round trip is exact on whole degrees");
+static_assert(tempToDegrees(19950) == 200 && tempToDegrees(19949) == 199, "degree rounding");
+static_assert(tempToDegrees(-150) == -2, "negative degree rounding");
+static_assert(tempRatePerMinute(25, 1000) == 1500, "0.25°C/s is 15°C/min");
+static_assert(tempRatePerMinute(-100, 4000) == -1500, "falling rates are negative");
+static_assert(tempRatePerMinute(TEMP_C(300), 100) == TEMP_LIMIT, "rates saturate");
@@ -0,0 +1,79 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+//===========================================
+// Fixed-Point Temperature Representation
+//===========================================
+// The ATmega2560 has no FPU, so temperatures are carried end to end as
+// signed centi-degrees Celsius in an int16_t: 0.01°C resolution over
+// ±327.67°C. Rates of rise use the same type in centi-degrees per minute.
+
+typedef int16_t temp_t;
+
+#define TEMP_SCALE    100           // temp_t units per degree
+#define TEMP_LIMIT    32767         // Largest representable temperature
+#define TEMP_INVALID  ((temp_t)(-TEMP_LIMIT - 1))  // Sensor fault or no reading
+
+// Whole degrees to temp_t, for configuration constants
+#define TEMP_C(deg) ((temp_t)((deg) * TEMP_SCALE))
+
+/**
+ * @brief Clamp a wide intermediate result into the temp_t range
+ * @param value Value in centi-degrees
+ * @return Saturated temperature, never TEMP_INVALID
+ */
+inline constexpr temp_t tempSaturate(int32_t value) {
+    return value > TEMP_LIMIT ? TEMP_LIMIT :
+           (value < -TEMP_LIMIT ? -TEMP_LIMIT : (temp_t)value);
+}
+
+/**
+ * @brief Convert a MAX6675 reading (0.25°C steps) to temp_t
+ * @param quarters Temperature in quarter degrees
+ */
+inline constexpr temp_t tempFromQuarterDegrees(int16_t quarters) {
+    return tempSaturate((int32_t)quarters * (TEMP_SCALE / 4));
+}
+
+/**
+ * @brief Convert degrees Celsius to temp_t, rounding to nearest
+ * Intended for configuration and host tools, not the control path
+ */
+inline constexpr temp_t tempFromFloat(float celsius) {
+    return tempSaturate((int32_t)(celsius * TEMP_SCALE + (celsius < 0 ? -0.5f : 0.5f)));
+}
+
+/**
+ * @brief Convert temp_t to degrees Celsius
+ */
+inline constexpr float tempToFloat(temp_t t) {
+    return (float)t / TEMP_SCALE;
+}
+
+/**
+ * @brief Round temp_t to whole degrees
+ */
+inline constexpr int16_t tempToDegrees(temp_t t) {
+    return (int16_t)((t + (t < 0 ? -TEMP_SCALE / 2 : TEMP_SCALE / 2)) / TEMP_SCALE);
+}
+
+/**
+ * @brief Rate of change in centi-degrees per minute
+ * @param delta Temperature change over the interval (saturated to temp_t)
+ * @param intervalMs Interval length in milliseconds (non-zero)
+ */
+inline constexpr temp_t tempRatePerMinute(int32_t delta, uint32_t intervalMs) {
+    return tempSaturate((int32_t)tempSaturate(delta) * 60000L / (int32_t)intervalMs);
+}
+
+/**
+ * @brief Format a temperature with one decimal, e.g. "215.3"
+ * @param buffer Destination, at least 8 bytes
+ * @param t Temperature to format; TEMP_INVALID prints "---"
+ * @return buffer
+ */
+char* formatTemp(char* buffer, temp_t t);
+
+#endif // FIXED_POINT_H
@@ -0,0 +1,138 @@
+#include "GainSchedule.h"
+
+/**
+ * Convert floating point gains to Q8
+ * Only used when tuning or building tables, never in the control step
+ */
+GainSet makeGainSet(double kp, double ki, double kd) {
+    kp = max(kp, 0.0);
+    ki = max(ki, 0.0);
+    kd = max(kd, 0.0);
+    
+    // Clamping one gain alone would change the integral and derivative
+    // times; scaling all three keeps them
+    double largest = max(kp, max(ki, kd));
+    if (largest > PID_MAX_GAIN) {
+        double scale = PID_MAX_GAIN / largest;
+        kp *= scale;
+        ki *= scale;
+        kd *= scale;
+    }
+    
+    GainSet gains;
+    gains.kp = (uint16_t)(kp * PID_GAIN_SCALE + 0.5);
+    gains.ki = (uint16_t)(ki * PID_GAIN_SCALE + 0.5);
+    gains.kd = (uint16_t)(kd * PID_GAIN_SCALE + 0.5);
+    return gains;
+}
+
+/**
+ * Constructor: Start from the built-in schedule
+ */
+GainSchedule::GainSchedule() {
+    loadDefaults();
+}
+
+/**
+ * Fill the table from the tuning constants in RoasterConfig.h
+ */
+void GainSchedule::loadDefaults() {
+    bands[0] = 0;
+    bands[1] = TEMP_C(GAIN_BAND_1);
+    bands[2] = TEMP_C(GAIN_BAND_2);
+    bands[3] = TEMP_C(GAIN_BAND_3);
+
+    GainSet cons = makeGainSet(KP_CONS, KI_CONS, KD_CONS);
+    GainSet agg = makeGainSet(KP_AGG, KI_AGG, KD_AGG);
+
+    for (uint8_t stage = 0; stage < ROAST_STAGE_COUNT; stage++) {
+        bool gentle = stage == FIRST_CRACK || stage == DEVELOPMENT;
+        for (uint8_t band = 0; band < GAIN_BAND_COUNT; band++) {
+            // Conservative inside TEMP_THRESHOLD, aggressive beyond it
+            table[stage][band] = (gentle || band < 2) ? cons : agg;
+        }
+    }
+}
+
+/**
+ * Interpolate the gains for a stage and error
+ * @param stage Current roast stage
+ * @param error Setpoint minus measured temperature
+ * @return Gains for this operating point
+ */
+GainSet GainSchedule::lookup(RoastStage stage, temp_t error) const {
+    if (stage >= ROAST_STAGE_COUNT) {
+        stage = IDLE;
+    }
+    const GainSet* row = table[stage];
+    int32_t magnitude = error < 0 ? -(int32_t)error : error;
+
+    if (magnitude <= bands[0]) {
+        return row[0];
+    }
+    for (uint8_t band = 1; band < GAIN_BAND_COUNT; band++) {
+        if (magnitude < bands[band]) {
+            // Linear blend between the neighbouring breakpoints
+            int32_t span = (int32_t)bands[band] - bands[band - 1];
+            int32_t pos = magnitude - bands[band - 1];
+            const GainSet& lo = row[band - 1];
+            const GainSet& hi = row[band];
+            GainSet gains;
+            gains.kp = lo.kp + ((int32_t)hi.kp - lo.kp) * pos / span;
+            gains.ki = lo.ki + ((int32_t)hi.ki - lo.ki) * pos / span;
+            gains.kd = lo.kd + ((int32_t)hi.kd - lo.kd) * pos / span;
+            return gains;
+        }
+    }
+    return row[GAIN_BAND_COUNT - 1];
+}
+
+/**
+ * Replace the gains of one table cell
+ */
+void GainSchedule::setGains(RoastStage stage, uint8_t band, const GainSet& gains) {
+    if (stage < ROAST_STAGE_COUNT && band < GAIN_BAND_COUNT) {
+        table[stage][band] = gains;
+    }
+}
+
+/**
+ * Scale one gain by tuned / reference, or take the tuned gain outright
+ * when the reference is zero
+ */
+static uint32_t scaleGain(uint16_t gain, uint16_t reference, uint16_t tuned) {
+    if (reference == 0) {
+        return tuned;
+    }
+    return (uint32_t)gain * tuned / reference;
+}
+
+/**
+ * Rescale every stage so its first band equals the tuned gains
+ * A cell with a gain past PID_MAX_GAIN has all three scaled down together
+ * @return true if any cell had to be scaled down
+ */
+bool GainSchedule::retune(const GainSet& tuned) {
+    uint32_t limit = (uint32_t)(PID_MAX_GAIN * PID_GAIN_SCALE);
+    bool limited = false;
+    for (uint8_t stage = 0; stage < ROAST_STAGE_COUNT; stage++) {
+        GainSet reference = table[stage][0];
+        for (uint8_t band = 0; band < GAIN_BAND_COUNT; band++) {
+            GainSet& cell = table[stage][band];
+            uint32_t kp = scaleGain(cell.kp, reference.kp, tuned.kp);
+            uint32_t ki = scaleGain(cell.ki, reference.ki, tuned.ki);
+            uint32_t kd = scaleGain(cell.kd, reference.kd, tuned.kd);
+            uint32_t largest = max(kp, max(ki, kd));
+            if (largest > limit) {
+                kp = (uint64_t)kp * limit / largest;
+                ki = (uint64_t)ki * limit / largest;
+                kd = (uint64_t)kd * limit / largest;
+                limited = true;
+            }
+            cell.kp = kp;
+            cell.ki = ki;
+            cell.kd = kd;
+        }
+    }
+    return limited;
+}
@@ -0,0 +1,84 @@
+#ifndef GAIN_SCHEDULE_H
+#define GAIN_SCHEDULE_H
+
+#include "RoasterConfig.h"
+
+/**
+ * @struct GainSet
+ * @brief One set of PID gains in Q8 fixed point (gain * PID_GAIN_SCALE)
+ */
+struct GainSet {
+    uint16_t kp;    // Proportional gain
+    uint16_t ki;    // Integral gain
+    uint16_t kd;    // Derivative gain
+};
+
+/**
+ * @brief Build a Q8 gain set
+ * If a gain is past PID_MAX_GAIN, all three are scaled down by the same
+ * factor so the integral and derivative times are kept
+ */
+GainSet makeGainSet(double kp, double ki, double kd);
+
+/**
+ * @class GainSchedule
+ * @brief PID gain table indexed by roast stage and error band
+ * 
+ * Each stage has GAIN_BAND_COUNT gain sets, one per breakpoint of the
+ * absolute setpoint error. Gains between two breakpoints are linearly
+ * interpolated; errors past the last breakpoint use the last set.
+ */
+class GainSchedule {
+    private:
+        temp_t bands[GAIN_BAND_COUNT];                      // Error breakpoints, ascending
+        GainSet table[ROAST_STAGE_COUNT][GAIN_BAND_COUNT];  // Gains per stage and band
+        
+    public:
+        /**
+         * @brief Constructor - fills the table with the default schedule
+         */
+        GainSchedule();
+        
+        /**
+         * @brief Restore the built-in schedule
+         * Conservative gains near the setpoint blending to aggressive
+         * gains far from it; from first crack on only conservative gains
+         * are used to avoid overshoot during the exothermic phase
+         */
+        void loadDefaults();
+        
+        /**
+         * @brief Look up interpolated gains
+         * @param stage Current roast stage
+         * @param error Setpoint minus measured temperature
+         */
+        GainSet lookup(RoastStage stage, temp_t error) const;
+        
+        /**
+         * @brief Replace the gains of one table cell
+         */
+        void setGains(RoastStage stage, uint8_t band, const GainSet& gains);
+        
+        /**
+         * @brief Rescale the table to newly tuned near-setpoint gains
+         * Each stage's first band becomes the tuned set and its other
+         * bands keep their ratio to the first, so the aggressive and
+         * gentle shaping of the schedule survives a retune. A cell that
+         * would pass PID_MAX_GAIN is scaled down like makeGainSet()
+         * @return true if any cell was scaled down
+         */
+        bool retune(const GainSet& tuned);
+        
+        /**
+         * @brief Get the error breakpoint of a band
+         */
+        temp_t getBand(uint8_t band) const { return bands[band]; }
+        
+        /**
+         * @brief Raw table access for loading and saving
+         */
+        temp_t* getBands() { return bands; }
+        GainSet* getTable() { return &table[0][0]; }
+};
+
+#endif // GAIN_SCHEDULE_H
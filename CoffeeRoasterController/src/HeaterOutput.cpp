@@ -0,0 +1,178 @@
+#include "HeaterOutput.h"
+
+// Output steps per second, nominally one per mains half-cycle
+#define HEATER_TICK_HZ (2 * HEATER_MAINS_HZ)
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+
+// Timer2 in CTC mode at clk/1024; 155 gives 100.2 Hz at 16 MHz
+#define HEATER_TIMER_TOP (F_CPU / 1024 / HEATER_TICK_HZ - 1)
+static_assert(HEATER_TIMER_TOP > 0 && HEATER_TIMER_TOP <= 255, "half-cycle period must fit Timer2");
+
+ISR(TIMER2_COMPA_vect) {
+    HeaterOutput::timerTick();
+}
+#endif
+
+HeaterOutput* HeaterOutput::active = nullptr;
+
+/**
+ * Constructor: Heater off in the configured mode
+ * @param outputPin Pin driving the SSR input
+ */
+HeaterOutput::HeaterOutput(uint8_t outputPin) {
+    pin = outputPin;
+    mode = HEATER_MODE;
+    duty = 0;
+    windowTicks = (uint32_t)HEATER_WINDOW * HEATER_TICK_HZ / 1000;
+    phase = 0;
+    accumulator = 0;
+    firing = false;
+    missedCrossings = 0;
+    zeroCrossFaults = 0;
+    on = false;
+    locked = false;
+}
+
+/**
+ * Drive the SSR low before the interrupts can switch it
+ */
+void HeaterOutput::begin() {
+    pinMode(pin, OUTPUT);
+    write(false);
+    active = this;
+    
+#ifdef HEATER_ZERO_CROSS
+    pinMode(HEATER_ZERO_CROSS_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(HEATER_ZERO_CROSS_PIN), zeroCrossTick, RISING);
+#endif
+    startTimer();
+}
+
+void HeaterOutput::startTimer() {
+#ifdef __AVR__
+    noInterrupts();
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+    OCR2A = HEATER_TIMER_TOP;
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A);
+    TIMSK2 |= _BV(OCIE2A);
+    interrupts();
+#else
+    hal::attachTimer(1000000UL / HEATER_TICK_HZ, timerTick);
+#endif
+}
+
+/**
+ * Set the duty picked up at the next half-cycle
+ * A single byte, so no interrupt lock is needed
+ */
+void HeaterOutput::setDuty(uint8_t value) {
+    duty = value;
+}
+
+/**
+ * With the duty at zero no later step can switch the pin back on
+ */
+void HeaterOutput::off() {
+    duty = 0;
+    write(false);
+}
+
+/**
+ * The lock is checked in step(), inside the interrupt, so a setDuty()
+ * racing with it cannot switch the heater back on
+ */
+void HeaterOutput::lock() {
+    locked = true;
+    off();
+}
+
+void HeaterOutput::unlock() {
+    locked = false;
+}
+
+void HeaterOutput::setMode(HeaterMode newMode) {
+    noInterrupts();
+    mode = newMode;
+    phase = 0;
+    accumulator = 0;
+    firing = false;
+    interrupts();
+}
+
+void HeaterOutput::setWindow(uint16_t windowMs) {
+    uint16_t ticks = max((uint32_t)windowMs * HEATER_TICK_HZ / 1000, (uint32_t)1);
+    noInterrupts();
+    windowTicks = ticks;
+    if (mode == HEATER_TIME_PROPORTIONAL) {
+        phase = 0;
+    }
+    interrupts();
+}
+
+unsigned long HeaterOutput::getZeroCrossFaults() {
+    noInterrupts();
+    unsigned long faults = zeroCrossFaults;
+    interrupts();
+    return faults;
+}
+
+void HeaterOutput::write(bool level) {
+    digitalWrite(pin, level ? HIGH : LOW);
+    on = level;
+}
+
+void HeaterOutput::step() {
+    uint8_t request = locked ? 0 : duty;
+    bool level;
+    
+    if (mode == HEATER_TIME_PROPORTIONAL) {
+        // On for the first part of each window; a new duty applies at once
+        level = phase < (uint32_t)request * windowTicks / PWM_MAX;
+        if (++phase >= windowTicks) {
+            phase = 0;
+        }
+    } else {
+        // Fire a cycle of two ticks whenever the owed energy reaches one;
+        // the second tick follows the first unless the duty was cut
+        if (phase == 0) {
+            accumulator += request;
+            firing = accumulator >= PWM_MAX;
+            if (firing) {
+                accumulator -= PWM_MAX;
+            }
+        }
+        level = firing && request > 0;
+        phase ^= 1;
+    }
+    write(level);
+}
+
+void HeaterOutput::timerTick() {
+    HeaterOutput* heater = active;
+    if (!heater) {
+        return;
+    }
+    
+#ifdef HEATER_ZERO_CROSS
+    // Pulses step the output; the timer only notices when they stop
+    if (heater->missedCrossings < HEATER_ZERO_CROSS_TIMEOUT
+        && ++heater->missedCrossings == HEATER_ZERO_CROSS_TIMEOUT) {
+        heater->zeroCrossFaults++;
+        heater->write(false);
+    }
+#else
+    heater->step();
+#endif
+}
+
+void HeaterOutput::zeroCrossTick() {
+    HeaterOutput* heater = active;
+    if (heater) {
+        heater->missedCrossings = 0;
+        heater->step();
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef HEATER_OUTPUT_H
+#define HEATER_OUTPUT_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+
+// How a duty is spread over mains half-cycles
+enum HeaterMode {
+    HEATER_BURST_FIRE,          // On cycles spread evenly, 1/255 resolution
+    HEATER_TIME_PROPORTIONAL    // One on period per HEATER_WINDOW
+};
+
+/**
+ * @class HeaterOutput
+ * @brief Interrupt-driven SSR output for the AC heater
+ * 
+ * HEAT_PIN has no hardware PWM, and a zero-crossing SSR could not follow
+ * one anyway, so the pin is switched once per half-cycle tick from a
+ * Timer2 compare interrupt. Burst fire spreads on cycles evenly with an
+ * error accumulator, each cycle being two ticks; time-proportioning turns
+ * the heater on for the first part of every HEATER_WINDOW, for mechanical
+ * relays or installations that prefer fewer switching events.
+ * 
+ * By default the timer free-runs near twice the mains frequency (100.2 Hz
+ * for 50 Hz mains at 16 MHz) and is not locked to the mains. The SSR
+ * still switches only at zero crossings, but the ticks drift against
+ * them, so now and then a burst conducts one half-cycle more or fewer
+ * than it should and the load sees a little half-wave DC.
+ * 
+ * With HEATER_ZERO_CROSS defined the output steps on pulses from a
+ * zero-cross detector instead, so burst fire switches whole mains cycles
+ * and never half-wave DC. The timer then only watches for the pulses: if
+ * HEATER_ZERO_CROSS_TIMEOUT half-cycles pass without one the heater is
+ * cut until pulses return.
+ * 
+ * Timer2 is taken over in CTC mode, so analogWrite() on pins 9 and 10
+ * and tone() are unavailable.
+ */
+class HeaterOutput {
+    private:
+        static HeaterOutput* active;    // Instance driven by the interrupts
+        
+        uint8_t pin;
+        uint8_t mode;                   // HeaterMode
+        volatile uint8_t duty;          // Requested duty (0-255)
+        uint16_t windowTicks;           // Half-cycles per time-proportioning window
+        uint16_t phase;                 // Tick within the window or burst-fire cycle
+        uint16_t accumulator;           // Burst-fire error, in duty counts
+        bool firing;                    // Burst fire: the current cycle is on
+        volatile uint8_t missedCrossings; // Timer ticks since the last zero-cross
+        volatile unsigned long zeroCrossFaults; // Times the zero-cross signal was lost
+        volatile bool on;               // Current pin state
+        volatile bool locked;           // Held off by the safety interlock
+        
+        /**
+         * @brief Advance one half-cycle and set the pin
+         */
+        void step();
+        
+        /**
+         * @brief Drive the pin and remember its state
+         */
+        void write(bool level);
+        
+        /**
+         * @brief Configure Timer2 for one interrupt per half-cycle
+         */
+        void startTimer();
+        
+    public:
+        /**
+         * @brief Constructor
+         * @param outputPin Pin driving the SSR input
+         */
+        HeaterOutput(uint8_t outputPin);
+        
+        /**
+         * @brief Drive the pin low and start the interrupts
+         */
+        void begin();
+        
+        /**
+         * @brief Set the heater duty
+         * @param value 0 (off) to PWM_MAX (full power)
+         */
+        void setDuty(uint8_t value);
+        
+        /**
+         * @brief Get the requested duty
+         */
+        uint8_t getDuty() { return duty; }
+        
+        /**
+         * @brief Cut the heater now rather than at the next half-cycle
+         */
+        void off();
+        
+        /**
+         * @brief Hold the heater off whatever duty is set, until unlock()
+         * Safe to call from an interrupt
+         */
+        void lock();
+        
+        /**
+         * @brief Let setDuty() drive the heater again
+         */
+        void unlock();
+        
+        /**
+         * @brief Check if the heater is held off
+         */
+        bool isLocked() { return locked; }
+        
+        /**
+         * @brief Change how the duty is spread over half-cycles
+         */
+        void setMode(HeaterMode newMode);
+        
+        /**
+         * @brief Change the time-proportioning window
+         * @param windowMs Window length in milliseconds
+         */
+        void setWindow(uint16_t windowMs);
+        
+        /**
+         * @brief Check if the SSR is driven on right now
+         */
+        bool isOn() { return on; }
+        
+        /**
+         * @brief Number of times the zero-cross signal was lost
+         */
+        unsigned long getZeroCrossFaults();
+        
+        /**
+         * @brief Timer2 compare handler; called from the interrupt only
+         */
+        static void timerTick();
+        
+        /**
+         * @brief Zero-cross pulse handler; called from the interrupt only
+         */
+        static void zeroCrossTick();
+};
+
+#endif // HEATER_OUTPUT_H
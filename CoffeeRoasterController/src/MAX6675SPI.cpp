@@ -0,0 +1,47 @@
+#include "MAX6675SPI.h"
+
+// MAX6675 clocks out up to 4.3 MHz; data is valid on the rising edge
+#define MAX6675_SPI_CLOCK 4000000
+// Bit 2 of the register is set when no thermocouple is attached
+#define MAX6675_OPEN_BIT  0x0004
+
+/**
+ * Constructor: Store chip select and bus settings
+ */
+MAX6675SPI::MAX6675SPI(uint8_t cs) : settings(MAX6675_SPI_CLOCK, MSBFIRST, SPI_MODE0) {
+    csPin = cs;
+}
+
+/**
+ * Deselect the sensor so it keeps converting
+ * SPI.begin() must have been called before the first read
+ */
+void MAX6675SPI::begin() {
+    pinMode(csPin, OUTPUT);
+    digitalWrite(csPin, HIGH);
+}
+
+/**
+ * Clock the 16-bit register out in one transaction
+ * @return Raw register value
+ */
+uint16_t MAX6675SPI::readRaw() {
+    SPI.beginTransaction(settings);
+    digitalWrite(csPin, LOW);
+    uint16_t value = SPI.transfer16(0);
+    digitalWrite(csPin, HIGH);
+    SPI.endTransaction();
+    return value;
+}
+
+/**
+ * Read temperature in centi-degrees
+ * @return Temperature with 0.25°C resolution, TEMP_INVALID on open thermocouple
+ */
+temp_t MAX6675SPI::readTemp() {
+    uint16_t value = readRaw();
+    if (value & MAX6675_OPEN_BIT) {
+        return TEMP_INVALID;
+    }
+    return tempFromQuarterDegrees(value >> 3);
+}
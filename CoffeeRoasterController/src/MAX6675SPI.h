@@ -0,0 +1,45 @@
+#ifndef MAX6675_SPI_H
+#define MAX6675_SPI_H
+
+#include <SPI.h>
+#include "RoasterConfig.h"
+
+/**
+ * @class MAX6675SPI
+ * @brief MAX6675 thermocouple driver on the hardware SPI bus
+ * 
+ * Reads the converter through the SPI peripheral shared with the SD
+ * card. Each read is wrapped in an SPI transaction so the bus settings
+ * never leak between devices; only a chip select pin is needed per sensor.
+ */
+class MAX6675SPI {
+    private:
+        uint8_t csPin;              // Chip select for this sensor
+        SPISettings settings;       // Bus settings for the MAX6675
+        
+    public:
+        /**
+         * @brief Constructor
+         * @param cs Chip select pin of the sensor
+         */
+        MAX6675SPI(uint8_t cs);
+        
+        /**
+         * @brief Configure the chip select pin
+         */
+        void begin();
+        
+        /**
+         * @brief Read the raw 16-bit conversion register
+         * @return Register contents (temperature in bits 14..3)
+         */
+        uint16_t readRaw();
+        
+        /**
+         * @brief Read the temperature
+         * @return Temperature, or TEMP_INVALID if the thermocouple is open
+         */
+        temp_t readTemp();
+};
+
+#endif // MAX6675_SPI_H
@@ -0,0 +1,152 @@
+#include "PIDAutotune.h"
+
+// Tyreus–Luyben PID rules: Kp = Ku / 3.2, Ti = 2.2 Pu, Td = Pu / 6.3
+#define TL_KP_DIVISOR 3.2
+#define TL_TI_FACTOR 2.2
+#define TL_TD_DIVISOR 6.3
+
+PIDAutotune::PIDAutotune() {
+    state = AUTOTUNE_OFF;
+    setpoint = 0;
+    hysteresis = TEMP_C(AUTOTUNE_HYSTERESIS);
+    relayHigh = true;
+    bias = PWM_MAX / 2;
+    swing = PWM_MAX / 2;
+    startTime = lowSwitchTime = highSwitchTime = 0;
+    cycleMax = cycleMin = 0;
+    warmedUp = false;
+    cycles = 0;
+    periods[0] = periods[1] = 0;
+    amplitudes[0] = amplitudes[1] = 0;
+    ultimateGain = 0;
+    ultimatePeriod = 0;
+}
+
+/**
+ * Start with the relay high and the bias at half power
+ */
+void PIDAutotune::start(temp_t target) {
+    setpoint = target;
+    state = AUTOTUNE_RUNNING;
+    relayHigh = true;
+    bias = PWM_MAX / 2;
+    swing = min(bias, (int16_t)(PWM_MAX - bias));
+    startTime = millis();
+    lowSwitchTime = highSwitchTime = startTime;
+    cycleMax = cycleMin = 0;
+    warmedUp = false;
+    cycles = 0;
+    periods[0] = periods[1] = 0;
+    amplitudes[0] = amplitudes[1] = 0;
+    ultimateGain = 0;
+    ultimatePeriod = 0;
+}
+
+void PIDAutotune::cancel() {
+    if (state == AUTOTUNE_RUNNING) {
+        state = AUTOTUNE_OFF;
+    }
+}
+
+uint8_t PIDAutotune::update(temp_t temp, unsigned long now) {
+    if (state != AUTOTUNE_RUNNING) {
+        return PWM_MIN;
+    }
+    if (temp == TEMP_INVALID || now - startTime > AUTOTUNE_TIMEOUT) {
+        state = AUTOTUNE_FAILED;
+        return PWM_MIN;
+    }
+
+    if (temp > cycleMax) {
+        cycleMax = temp;
+    }
+    if (temp < cycleMin) {
+        cycleMin = temp;
+    }
+
+    if (relayHigh && temp > setpoint + hysteresis) {
+        relayHigh = false;
+        // The first crossing only ends the warm-up from room temperature
+        if (warmedUp) {
+            endCycle(now);
+        }
+        warmedUp = true;
+        lowSwitchTime = now;
+        cycleMax = cycleMin = temp;
+    } else if (!relayHigh && temp < setpoint - hysteresis) {
+        relayHigh = true;
+        highSwitchTime = now;
+    }
+
+    return relayHigh ? bias + swing : bias - swing;
+}
+
+// A cycle runs from one switch to low to the next, so it holds one peak
+// and one trough
+void PIDAutotune::endCycle(unsigned long now) {
+    unsigned long period = now - lowSwitchTime;
+    unsigned long highTime = now - highSwitchTime;
+
+    periods[1] = periods[0];
+    amplitudes[1] = amplitudes[0];
+    periods[0] = period;
+    amplitudes[0] = (cycleMax - cycleMin) / 2;
+    cycles++;
+
+    evaluate();
+    if (state != AUTOTUNE_RUNNING) {
+        return;
+    }
+
+    // Heating faster than cooling means too much average power: move the
+    // bias by half the imbalance for the next cycle
+    int32_t imbalance = (int32_t)highTime - (int32_t)(period - highTime);
+    int32_t shift = (int32_t)swing * imbalance / (int32_t)(2 * period);
+    bias = constrain(bias + shift, AUTOTUNE_MIN_SWING, PWM_MAX - AUTOTUNE_MIN_SWING);
+    swing = min(bias, (int16_t)(PWM_MAX - bias));
+}
+
+void PIDAutotune::evaluate() {
+    if (cycles < AUTOTUNE_MIN_CYCLES) {
+        return;
+    }
+
+    // Steady once the last two cycles agree in length and height
+    unsigned long periodDiff = periods[0] > periods[1] ? periods[0] - periods[1] : periods[1] - periods[0];
+    int32_t amplitudeDiff = abs((int32_t)amplitudes[0] - amplitudes[1]);
+    if (periodDiff * 100 > periods[0] * AUTOTUNE_TOLERANCE
+        || amplitudeDiff * 100 > (int32_t)amplitudes[0] * AUTOTUNE_TOLERANCE) {
+        return;
+    }
+
+    float a = (float)amplitudes[0] / TEMP_SCALE;
+    float e = (float)hysteresis / TEMP_SCALE;
+    if (a <= e) {
+        state = AUTOTUNE_FAILED;
+        return;
+    }
+
+    ultimateGain = 4.0 * swing / (PI * sqrt(a * a - e * e));
+    ultimatePeriod = (periods[0] + periods[1]) / 2000.0;
+    state = AUTOTUNE_DONE;
+}
+
+void PIDAutotune::tuningRules(float* kp, float* ki, float* kd) {
+    float ti = TL_TI_FACTOR * ultimatePeriod;
+    float td = ultimatePeriod / TL_TD_DIVISOR;
+    *kp = ultimateGain / TL_KP_DIVISOR;
+    *ki = *kp / ti;
+    *kd = *kp * td;
+}
+
+GainSet PIDAutotune::getGains() {
+    float kp, ki, kd;
+    tuningRules(&kp, &ki, &kd);
+    return makeGainSet(kp, ki, kd);
+}
+
+bool PIDAutotune::gainsLimited() {
+    float kp, ki, kd;
+    tuningRules(&kp, &ki, &kd);
+    return max(kp, max(ki, kd)) > PID_MAX_GAIN;
+}
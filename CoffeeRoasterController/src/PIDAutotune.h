@@ -0,0 +1,116 @@
+#ifndef PID_AUTOTUNE_H
+#define PID_AUTOTUNE_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+#include "GainSchedule.h"
+
+enum AutotuneState {
+    AUTOTUNE_OFF,
+    AUTOTUNE_RUNNING,
+    AUTOTUNE_DONE,
+    AUTOTUNE_FAILED
+};
+
+/**
+ * @class PIDAutotune
+ * @brief Relay feedback autotuner (Åström–Hägglund)
+ *
+ * Drives the heater with a relay that switches low above setpoint +
+ * AUTOTUNE_HYSTERESIS and high below setpoint - AUTOTUNE_HYSTERESIS, so
+ * the temperature settles into a limit cycle. The relay bias is moved
+ * after every cycle until heating and cooling take equal time, which
+ * keeps the oscillation centered on the setpoint even though the roaster
+ * loses heat to the room.
+ *
+ * Once the last two cycles agree within AUTOTUNE_TOLERANCE, the ultimate
+ * gain comes from the describing function of a relay with hysteresis,
+ * Ku = 4d / (pi * sqrt(a^2 - e^2)), and the ultimate period is the cycle
+ * length. Gains use the Tyreus–Luyben rules, which overshoot less than
+ * Ziegler–Nichols on lag-dominated thermal processes.
+ */
+class PIDAutotune {
+    private:
+        temp_t setpoint;
+        temp_t hysteresis;
+        uint8_t state;              // AutotuneState
+        bool relayHigh;
+        bool warmedUp;              // Passed the setpoint once since start()
+        int16_t bias;               // Relay midpoint in PWM counts
+        int16_t swing;              // Relay output either side of the bias
+        unsigned long startTime;
+        unsigned long lowSwitchTime;  // Last switch to low, ends a cycle
+        unsigned long highSwitchTime; // Last switch to high
+        temp_t cycleMax, cycleMin;  // Extremes since the last switch to low
+        uint8_t cycles;             // Complete cycles measured
+        unsigned long periods[2];   // Last two cycle lengths in ms, newest first
+        temp_t amplitudes[2];       // Last two peak amplitudes, newest first
+        float ultimateGain;         // PWM counts per °C
+        float ultimatePeriod;       // Seconds
+
+        /**
+         * @brief Record a finished cycle and rebalance the relay
+         */
+        void endCycle(unsigned long now);
+
+        /**
+         * @brief Check the last two cycles and compute the result
+         */
+        void evaluate();
+
+        /**
+         * @brief Tyreus–Luyben gains before conversion to Q8
+         */
+        void tuningRules(float* kp, float* ki, float* kd);
+
+    public:
+        PIDAutotune();
+
+        /**
+         * @brief Start a test around a setpoint
+         */
+        void start(temp_t target);
+
+        /**
+         * @brief Abandon a running test
+         */
+        void cancel();
+
+        /**
+         * @brief Advance the test by one control step
+         * @param temp Measured temperature
+         * @param now Current time in ms
+         * @return Heater output for this step
+         */
+        uint8_t update(temp_t temp, unsigned long now);
+
+        /**
+         * @brief Current AutotuneState
+         */
+        uint8_t getState() { return state; }
+        bool isRunning() { return state == AUTOTUNE_RUNNING; }
+
+        /**
+         * @brief Measured cycles so far, for progress display
+         */
+        uint8_t getCycles() { return cycles; }
+
+        /**
+         * @brief Identified ultimate gain (counts/°C) and period (s)
+         */
+        float getUltimateGain() { return ultimateGain; }
+        float getUltimatePeriod() { return ultimatePeriod; }
+
+        /**
+         * @brief Tyreus–Luyben gains from the identified Ku and Pu
+         * Scaled down together if one is past PID_MAX_GAIN
+         */
+        GainSet getGains();
+
+        /**
+         * @brief Check if getGains() had to scale the gains down to fit
+         */
+        bool gainsLimited();
+};
+
+#endif
@@ -1,57 +1,162 @@
 #include "PIDController.h"
+#include "Profiler.h"
+
+// Per-step integral increments are clamped so rate * PID_MAX_DT fits in int32
+#define PID_MAX_INTEGRAL_RATE 2000000L
 
 /**
  * Constructor: Initialize PID controller
  * Sets up PID with conservative tuning parameters
  */
 PIDController::PIDController() {
-    input = 0;
-    output = 0;
     setpoint = 0;
-    // Create PID controller with conservative tuning
-    pid = new PID(&input, &output, &setpoint, KP_CONS, KI_CONS, KD_CONS, DIRECT);
+    lastInput = 0;
+    integral = 0;
+    derivative = 0;
+    feedForward = 0;
+    output = 0;
+    initialized = false;
+    kp = ki = kd = 0;
+    outMin = (int32_t)PWM_MIN * PID_GAIN_SCALE;
+    outMax = (int32_t)PWM_MAX * PID_GAIN_SCALE;
+    tune(KP_CONS, KI_CONS, KD_CONS);
 }
 
 /**
  * Initialize PID controller
- * Sets up automatic mode and output limits
+ * Starts from a clean state with conservative tuning
  */
 void PIDController::begin() {
-    pid->SetMode(AUTOMATIC);    // Enable automatic PID control
-    pid->SetOutputLimits(0, 255); // Set PWM output range
-    aggressive = false;         // Start with conservative tuning
+    integral = 0;
+    derivative = 0;
+    feedForward = 0;
+    output = 0;
+    initialized = false;
+    tune(KP_CONS, KI_CONS, KD_CONS);
 }
 
 /**
- * Calculate PID output
- * Should be called regularly in the main loop
+ * Run one PID step
+ * Should be called at a steady rate with the measured time step
+ * @param temp Current measured temperature
+ * @param dtMs Time since the previous call in milliseconds
  */
-void PIDController::compute() {
-    pid->Compute();
+void PIDController::compute(temp_t temp, uint16_t dtMs) {
+    TIME_SECTION(SECTION_PID);
+    
+    // Never drive the heater from a faulted reading
+    if (temp == TEMP_INVALID) {
+        output = PWM_MIN;
+        return;
+    }
+    if (!initialized) {
+        reset(temp);
+    }
+    if (dtMs > PID_MAX_DT) {
+        dtMs = PID_MAX_DT;
+    }
+
+    // Error in centi-degrees; saturating keeps kp * error inside int32
+    int32_t error = tempSaturate((int32_t)setpoint - temp);
+
+    if (dtMs > 0) {
+        // Integrate, clamping the per-step rate before scaling by dt
+        int32_t rate = ki * error / TEMP_SCALE;
+        rate = constrain(rate, -PID_MAX_INTEGRAL_RATE, PID_MAX_INTEGRAL_RATE);
+        integral += rate * dtMs;
+
+        // Derivative on measurement avoids kicks on setpoint changes
+        int32_t slope = ((int32_t)temp - lastInput) * 1000L / dtMs;
+        slope = tempSaturate(slope);
+        derivative += (slope - derivative) * dtMs / (PID_DERIVATIVE_FILTER + dtMs);
+    }
+    lastInput = temp;
+
+    // Integrator clamping to the output range
+    integral = constrain(integral, outMin * 1000L, outMax * 1000L);
+
+    int32_t unsaturated = proportionalDerivative() + integral / 1000 + feedForward;
+    int32_t saturated = constrain(unsaturated, outMin, outMax);
+
+    // Back-calculation: bleed the integrator while the output is saturated
+    if (saturated != unsaturated && dtMs > 0) {
+        int32_t excess = constrain(saturated - unsaturated, -outMax, outMax);
+        integral += excess * dtMs / PID_TRACKING_TIME * 1000L;
+        integral = constrain(integral, outMin * 1000L, outMax * 1000L);
+    }
+
+    output = (saturated + PID_GAIN_SCALE / 2) / PID_GAIN_SCALE;
+}
+
+/**
+ * Clear controller history
+ * @param temp Current measured temperature
+ */
+void PIDController::reset(temp_t temp) {
+    lastInput = temp;
+    integral = 0;
+    derivative = 0;
+    initialized = temp != TEMP_INVALID;
 }
 
 /**
  * Update temperature setpoint
  * @param sp New target temperature
  */
-void PIDController::setSetpoint(double sp) {
+void PIDController::setSetpoint(temp_t sp) {
     setpoint = sp;
 }
 
 /**
- * Switch between aggressive and conservative PID tuning
- * @param agg true for aggressive tuning, false for conservative
+ * Set the feed-forward output offset
+ * Saturation still applies to the sum, so the integrator backs off when
+ * the feed-forward alone drives the output to a limit
+ * @param counts Offset in PWM counts
+ */
+void PIDController::setFeedForward(int16_t counts) {
+    feedForward = (int32_t)counts * PID_GAIN_SCALE;
+}
+
+/**
+ * P and D terms in Q8 counts for the last measurement
+ */
+int32_t PIDController::proportionalDerivative() {
+    int32_t error = tempSaturate((int32_t)setpoint - lastInput);
+    return kp * error / TEMP_SCALE - kd * derivative / TEMP_SCALE;
+}
+
+/**
+ * Pick gains for the current stage and error from the schedule
+ * Called from the control loop before compute()
+ * @param stage Current roast stage
+ * @param temp Current measured temperature
  */
-void PIDController::switchToAggressive(bool agg) {
-    if (agg != aggressive) {
-        aggressive = agg;
-        if (aggressive) {
-            // Switch to aggressive tuning for faster response
-            pid->SetTunings(KP_AGG, KI_AGG, KD_AGG);
-        } else {
-            // Switch to conservative tuning for stability
-            pid->SetTunings(KP_CONS, KI_CONS, KD_CONS);
-        }
+void PIDController::applySchedule(RoastStage stage, temp_t temp) {
+    if (temp == TEMP_INVALID) {
+        return;
+    }
+    setGains(schedule.lookup(stage, tempSaturate((int32_t)setpoint - temp)));
+}
+
+/**
+ * Switch gains bumplessly
+ * The integrator is re-initialized to absorb the change in the P and D
+ * terms, so the output stays where it was and only future dynamics change
+ * @param gains New Q8 gains
+ */
+void PIDController::setGains(const GainSet& gains) {
+    if (gains.kp == kp && gains.ki == ki && gains.kd == kd) {
+        return;
+    }
+    int32_t before = initialized ? proportionalDerivative() : 0;
+
+    kp = gains.kp;
+    ki = gains.ki;
+    kd = gains.kd;
+
+    if (initialized) {
+        int32_t shift = constrain(before - proportionalDerivative(), -outMax, outMax);
+        integral = constrain(integral + shift * 1000L, outMin * 1000L, outMax * 1000L);
     }
 }
 
@@ -59,7 +164,7 @@ void PIDController::switchToAggressive(bool agg) {
  * Get current PID output value
  * @return Current output value (0-255)
  */
-double PIDController::getOutput() {
+uint8_t PIDController::getOutput() {
     return output;
 }
 
@@ -70,5 +175,5 @@ double PIDController::getOutput() {
  * @param kd New derivative gain
  */
 void PIDController::tune(double kp, double ki, double kd) {
-    pid->SetTunings(kp, ki, kd);
-}
\ No newline at end of file
+    setGains(makeGainSet(kp, ki, kd));
+}
@@ -1,24 +1,45 @@
 #ifndef PID_CONTROLLER_H
 #define PID_CONTROLLER_H
 
-#include <PID_v1.h>  // Make sure this matches the installed library name
 #include "RoasterConfig.h"
+#include "GainSchedule.h"
 
 /**
  * @class PIDController
- * @brief Manages PID control with dual tuning modes
+ * @brief Manages PID control with scheduled gains
  * 
- * Implements PID control with switchable aggressive and conservative
- * tuning parameters for optimal temperature control during different
- * phases of the roast.
+ * Implements PID control whose gains follow a GainSchedule indexed by
+ * roast stage and setpoint error, for optimal temperature control
+ * during different phases of the roast. Gain changes are bumpless.
+ * 
+ * The controller runs entirely in integer arithmetic: gains are Q8 fixed
+ * point, temperatures are temp_t and the output is computed in Q8 PWM
+ * counts. Every call to compute() executes one step using the supplied
+ * time step, with integrator clamping and back-calculation anti-windup
+ * and a first-order filtered derivative taken on the measurement. A
+ * feed-forward term from the caller is added ahead of the output limits,
+ * so the integrator only has to correct what the model gets wrong.
  */
 class PIDController {
     private:
-        double input;     // Current temperature input
-        double output;    // Calculated PID output
-        double setpoint;  // Target temperature
-        PID *pid;        // PID controller instance
-        bool aggressive;  // Current PID mode flag
+        temp_t setpoint;      // Target temperature
+        temp_t lastInput;     // Measurement from the previous step
+        int32_t kp;           // Proportional gain, Q8 counts per °C
+        int32_t ki;           // Integral gain, Q8 counts per °C per second
+        int32_t kd;           // Derivative gain, Q8 counts per °C/s
+        int32_t integral;     // Integral term, Q8 counts x 1000
+        int32_t derivative;   // Filtered input slope, centi-degrees per second
+        int32_t outMin;       // Lower output limit, Q8 counts
+        int32_t outMax;       // Upper output limit, Q8 counts
+        int32_t feedForward;  // Added to the output, Q8 counts
+        uint8_t output;       // Last computed output (0-255)
+        bool initialized;     // lastInput holds a valid measurement
+        GainSchedule schedule; // Gain table used by applySchedule()
+        
+        /**
+         * @brief Output contribution of the P and D terms for current state
+         */
+        int32_t proportionalDerivative();
         
     public:
         /**
@@ -33,26 +54,52 @@ class PIDController {
         
         /**
          * @brief Calculate new PID output
+         * @param temp Current measured temperature
+         * @param dtMs Time since the previous call in milliseconds
          */
-        void compute();
+        void compute(temp_t temp, uint16_t dtMs);
+        
+        /**
+         * @brief Clear integrator and derivative history
+         * @param temp Current measured temperature
+         */
+        void reset(temp_t temp);
         
         /**
          * @brief Set target temperature
          * @param sp Desired temperature setpoint
          */
-        void setSetpoint(double sp);
+        void setSetpoint(temp_t sp);
+        
+        /**
+         * @brief Set the feed-forward added to every following output
+         * @param counts Output offset in PWM counts; 0 turns it off
+         */
+        void setFeedForward(int16_t counts);
+        
+        /**
+         * @brief Select gains from the schedule for the current operating point
+         * @param stage Current roast stage
+         * @param temp Current measured temperature
+         */
+        void applySchedule(RoastStage stage, temp_t temp);
+        
+        /**
+         * @brief Change gains without a step in the output
+         * @param gains New Q8 gains
+         */
+        void setGains(const GainSet& gains);
         
         /**
-         * @brief Switch between aggressive and conservative PID modes
-         * @param agg true for aggressive, false for conservative
+         * @brief Get the gain schedule, e.g. to load it from SD
          */
-        void switchToAggressive(bool agg);
+        GainSchedule* getSchedule() { return &schedule; }
         
         /**
          * @brief Get current PID output value
          * @return Current output (0-255)
          */
-        double getOutput();
+        uint8_t getOutput();
         
         /**
          * @brief Update PID tuning parameters
@@ -63,4 +110,4 @@ class PIDController {
         void tune(double kp, double ki, double kd);
 };
 
-#endif
\ No newline at end of file
+#endif
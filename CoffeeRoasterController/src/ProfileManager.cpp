@@ -1,9 +1,62 @@
 #include "ProfileManager.h"
+#include "Profiler.h"
 
-ProfileManager::ProfileManager() {
+// Unbounded slope for the swinging-door recorder
+#define DOOR_OPEN 0x7FFFFFFFL
+
+// Gain schedule file header
+#define GAIN_FILE_MAGIC   0x48435347UL  // "GSCH"
+#define GAIN_FILE_VERSION 1
+
+struct GainFileHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t stages;     // ROAST_STAGE_COUNT when written
+    uint8_t bands;      // GAIN_BAND_COUNT when written
+    uint8_t reserved;
+};
+
+static_assert(sizeof(ProfileIndexEntry) == 32, "index entries must tile a sector");
+static_assert(sizeof(ProfileIndexHeader) == sizeof(ProfileIndexEntry), "index header must keep entries aligned");
+static_assert(MAX_PROFILES % 8 == 0, "slot map holds whole bytes");
+static_assert(PROFILE_WINDOW <= 255, "window indices are 8 bit");
+
+/** Division rounding down, for a positive divisor */
+static int32_t divFloor(int32_t value, int32_t divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+/** CRC-16/CCITT (polynomial 0x1021), one byte at a time */
+static uint16_t crc16Update(uint16_t crc, const uint8_t* data, uint16_t length) {
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+ProfileManager::ProfileManager(SDWriteQueue* sdQueue) {
+    queue = sdQueue;
+    memset(slotMap, 0, sizeof(slotMap));
+    profileCount = 0;
+    indexReady = false;
     profileLoaded = false;
+    loadedSlot = -1;
+    windowStart = 0;
+    windowCount = 0;
+    cursor = 0;
+    oldestUsed = PROFILE_WINDOW;
+    starved = false;
+    underruns = 0;
+    hasPending = false;
+    recording = false;
+    recordCount = 0;
+    recordDuration = 0;
+    openDoor();
     // Initialize empty profile
-    memset(&currentProfile, 0, sizeof(RoastProfile));
+    memset(&header, 0, sizeof(header));
 }
 
 bool ProfileManager::begin() {
@@ -13,38 +66,214 @@ bool ProfileManager::begin() {
     }
     
     // Create profiles directory if it doesn't exist
-    if (!SD.exists("/profiles")) {
-        SD.mkdir("/profiles");
+    if (!SD.exists(PROFILE_DIRECTORY)) {
+        SD.mkdir(PROFILE_DIRECTORY);
     }
     
+    // Listing and saving work from the index; scan the card only if it is lost
+    indexReady = loadIndex() || rebuildIndex();
     return true;
 }
 
-String ProfileManager::getProfileFileName(int index) {
-    return String("/profiles/profile_") + String(index) + ".dat";
+void ProfileManager::getProfileFileName(char* buffer, uint16_t slot) {
+    sprintf(buffer, PROFILE_DIRECTORY "/prof%03u.dat", slot);
+}
+
+bool ProfileManager::slotUsed(uint16_t slot) {
+    return slot < MAX_PROFILES && (slotMap[slot >> 3] & (1 << (slot & 7)));
+}
+
+void ProfileManager::markSlot(uint16_t slot, bool used) {
+    if (slotUsed(slot) == used) {
+        return;
+    }
+    if (used) {
+        slotMap[slot >> 3] |= 1 << (slot & 7);
+        profileCount++;
+    } else {
+        slotMap[slot >> 3] &= ~(1 << (slot & 7));
+        profileCount--;
+    }
+}
+
+bool ProfileManager::loadIndex() {
+    File index = SD.open(PROFILE_INDEX_FILE, FILE_READ);
+    if (!index) {
+        return false;
+    }
+    
+    ProfileIndexHeader indexHeader;
+    bool ok = index.read((uint8_t*)&indexHeader, sizeof(indexHeader)) == sizeof(indexHeader)
+           && indexHeader.magic == PROFILE_INDEX_MAGIC
+           && indexHeader.version == PROFILE_INDEX_VERSION
+           && indexHeader.entrySize == sizeof(ProfileIndexEntry)
+           && indexHeader.slots == MAX_PROFILES;
+    
+    // One sequential pass over the entries
+    memset(slotMap, 0, sizeof(slotMap));
+    profileCount = 0;
+    ProfileIndexEntry entry;
+    for (uint16_t slot = 0; ok && slot < MAX_PROFILES; slot++) {
+        ok = index.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+        if (ok && (entry.flags & PROFILE_ENTRY_USED) && entry.slot == slot) {
+            markSlot(slot, true);
+        }
+    }
+    index.close();
+    return ok;
+}
+
+bool ProfileManager::rebuildIndex() {
+    File index = SD.open(PROFILE_INDEX_FILE, O_READ | O_WRITE | O_CREAT | O_TRUNC);
+    if (!index) {
+        return false;
+    }
+    
+    ProfileIndexHeader indexHeader;
+    memset(&indexHeader, 0, sizeof(indexHeader));
+    indexHeader.magic = PROFILE_INDEX_MAGIC;
+    indexHeader.version = PROFILE_INDEX_VERSION;
+    indexHeader.entrySize = sizeof(ProfileIndexEntry);
+    indexHeader.slots = MAX_PROFILES;
+    bool ok = index.write((const uint8_t*)&indexHeader, sizeof(indexHeader)) == sizeof(indexHeader);
+    
+    // Every slot gets an entry so later updates are in-place rewrites
+    memset(slotMap, 0, sizeof(slotMap));
+    profileCount = 0;
+    char fileName[24];
+    for (uint16_t slot = 0; ok && slot < MAX_PROFILES; slot++) {
+        ProfileIndexEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.slot = slot;
+        
+        getProfileFileName(fileName, slot);
+        File file = SD.open(fileName, FILE_READ);
+        if (file) {
+            RoastProfileHeader profile;
+            if (file.read((uint8_t*)&profile, sizeof(profile)) == sizeof(profile)
+                && profile.magic == PROFILE_MAGIC
+                && profile.version == PROFILE_VERSION) {
+                entry.flags = PROFILE_ENTRY_USED;
+                memcpy(entry.name, profile.name, PROFILE_NAME_LENGTH);
+                entry.duration = profile.duration;
+                uint32_t size;
+                entry.checksum = checksumFile(file, &size);
+                entry.size = size;
+                markSlot(slot, true);
+            }
+            file.close();
+        }
+        
+        ok = index.write((const uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+    }
+    index.close();
+    return ok;
+}
+
+bool ProfileManager::readIndexEntry(uint16_t slot, ProfileIndexEntry* entry) {
+    File index = SD.open(PROFILE_INDEX_FILE, FILE_READ);
+    if (!index) {
+        return false;
+    }
+    bool ok = index.seek(sizeof(ProfileIndexHeader) + (uint32_t)slot * sizeof(ProfileIndexEntry))
+           && index.read((uint8_t*)entry, sizeof(*entry)) == sizeof(*entry)
+           && entry->slot == slot;
+    index.close();
+    return ok;
+}
+
+bool ProfileManager::writeIndexEntry(const ProfileIndexEntry& entry) {
+    // Opened without O_APPEND so the entry is rewritten where it is
+    File index = SD.open(PROFILE_INDEX_FILE, O_READ | O_WRITE);
+    if (!index) {
+        return false;
+    }
+    bool ok = index.seek(sizeof(ProfileIndexHeader) + (uint32_t)entry.slot * sizeof(ProfileIndexEntry))
+           && index.write((const uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+    index.close();
+    return ok;
+}
+
+uint16_t ProfileManager::checksumFile(File& file, uint32_t* size) {
+    uint8_t buffer[sizeof(ProfileKeyframe) * PROFILE_WINDOW];
+    uint16_t crc = 0xFFFF;
+    int bytes;
+    
+    *size = 0;
+    file.seek(0);
+    while ((bytes = file.read(buffer, sizeof(buffer))) > 0) {
+        crc = crc16Update(crc, buffer, bytes);
+        *size += bytes;
+    }
+    return crc;
 }
 
-bool ProfileManager::loadProfile(int index) {
-    String fileName = getProfileFileName(index);
+bool ProfileManager::loadProfile(int slot) {
+    // Stop any current playback
+    if (profileFile) {
+        profileFile.close();
+    }
+    profileLoaded = false;
+    loadedSlot = -1;
     
-    // Open profile file
+    ProfileIndexEntry entry;
+    if (!slotUsed(slot) || !readIndexEntry(slot, &entry)) {
+        return false;
+    }
+    
+    // Open profile file; it stays open for streaming
+    char fileName[24];
+    getProfileFileName(fileName, slot);
     profileFile = SD.open(fileName, FILE_READ);
     if (!profileFile) {
         return false;
     }
     
-    // Read profile data
-    profileFile.read((uint8_t*)&currentProfile, sizeof(RoastProfile));
-    profileFile.close();
+    // The whole file must be what the index recorded at save time
+    uint32_t size;
+    bool ok = checksumFile(profileFile, &size) == entry.checksum
+           && size == entry.size
+           && profileFile.seek(0);
+    
+    // Read and validate the header before trusting the keyframe count
+    ok = ok && profileFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+           && header.magic == PROFILE_MAGIC
+           && header.version == PROFILE_VERSION
+           && header.sampleRate > 0;
+    
+    // Prime the playback window
+    windowStart = 0;
+    windowCount = 0;
+    cursor = 0;
+    oldestUsed = PROFILE_WINDOW;
+    starved = false;
+    underruns = 0;
+    if (ok) {
+        uint8_t want = min(header.keyframeCount, (uint16_t)PROFILE_WINDOW);
+        int bytes = profileFile.read((uint8_t*)window, want * sizeof(ProfileKeyframe));
+        windowCount = bytes / sizeof(ProfileKeyframe);
+        ok = windowCount == want;
+    }
+    
+    if (!ok) {
+        profileFile.close();
+        memset(&header, 0, sizeof(header));
+        return false;
+    }
     
     profileLoaded = true;
+    loadedSlot = slot;
     return true;
 }
 
 bool ProfileManager::saveProfile(const char* name) {
+    if (!recording || !indexReady) {
+        return false;
+    }
+    
     // Find first available slot
-    int slot = 0;
-    while (slot < MAX_PROFILES && SD.exists(getProfileFileName(slot))) {
+    uint16_t slot = 0;
+    while (slot < MAX_PROFILES && slotUsed(slot)) {
         slot++;
     }
     
@@ -52,77 +281,442 @@ bool ProfileManager::saveProfile(const char* name) {
         return false;
     }
     
-    // Update profile name
-    strncpy(currentProfile.name, name, PROFILE_NAME_LENGTH - 1);
-    currentProfile.name[PROFILE_NAME_LENGTH - 1] = '\0';
+    // Include the last recorded point and finish the keyframe stream
+    flushPending();
+    queue->sync(&recordFile);
+    recordFile.close();
     
-    // Save to file
-    String fileName = getProfileFileName(slot);
-    profileFile = SD.open(fileName, FILE_WRITE);
-    if (!profileFile) {
+    // Build profile header
+    RoastProfileHeader saved;
+    memset(&saved, 0, sizeof(saved));
+    saved.magic = PROFILE_MAGIC;
+    saved.version = PROFILE_VERSION;
+    saved.sampleRate = PROFILE_SAMPLE_RATE;
+    saved.duration = recordDuration;
+    saved.keyframeCount = recordCount;
+    strncpy(saved.name, name, PROFILE_NAME_LENGTH - 1);
+    
+    // Index entry, checksummed as the file is written
+    ProfileIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.flags = PROFILE_ENTRY_USED;
+    entry.slot = slot;
+    memcpy(entry.name, saved.name, PROFILE_NAME_LENGTH);
+    entry.duration = saved.duration;
+    entry.size = sizeof(saved);
+    entry.checksum = crc16Update(0xFFFF, (const uint8_t*)&saved, sizeof(saved));
+    
+    // Save to file: header, then the recorded keyframes. A stale file
+    // left in a free slot by an interrupted save is overwritten
+    char fileName[24];
+    getProfileFileName(fileName, slot);
+    File out = SD.open(fileName, O_READ | O_WRITE | O_CREAT | O_TRUNC);
+    File in = SD.open(PROFILE_RECORD_FILE, FILE_READ);
+    if (!out || !in) {
+        if (out) out.close();
+        if (in) in.close();
+        return resumeRecording();
+    }
+    
+    bool ok = out.write((uint8_t*)&saved, sizeof(saved)) == sizeof(saved);
+    uint8_t buffer[sizeof(ProfileKeyframe) * PROFILE_WINDOW];
+    int bytes;
+    while (ok && (bytes = in.read(buffer, sizeof(buffer))) > 0) {
+        ok = out.write(buffer, bytes) == (size_t)bytes;
+        entry.checksum = crc16Update(entry.checksum, buffer, bytes);
+        entry.size += bytes;
+    }
+    in.close();
+    out.close();
+    
+    // The index entry commits the save
+    if (!ok || !writeIndexEntry(entry)) {
+        return resumeRecording();
+    }
+    markSlot(slot, true);
+    recording = false;
+    SD.remove(PROFILE_RECORD_FILE);
+    
+    return true;
+}
+
+/**
+ * The keyframes are still in the record file. If it cannot be reopened
+ * they stay there, but recording stops
+ */
+bool ProfileManager::resumeRecording() {
+    recordFile = SD.open(PROFILE_RECORD_FILE, FILE_WRITE);
+    recording = recordFile;
+    return false;
+}
+
+bool ProfileManager::deleteProfile(int slot) {
+    if (!slotUsed(slot)) {
         return false;
     }
+    // Only the profile being played back has its file open
+    if (profileLoaded && slot == loadedSlot) {
+        profileFile.close();
+        profileLoaded = false;
+        loadedSlot = -1;
+    }
     
-    profileFile.write((uint8_t*)&currentProfile, sizeof(RoastProfile));
-    profileFile.close();
+    // Clear the entry first; a file without one is just a free slot
+    ProfileIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.slot = slot;
+    if (!writeIndexEntry(entry)) {
+        return false;
+    }
+    markSlot(slot, false);
     
+    char fileName[24];
+    getProfileFileName(fileName, slot);
+    SD.remove(fileName);
     return true;
 }
 
-float ProfileManager::getTargetTemp(unsigned long timeSeconds) {
-    if (!profileLoaded || timeSeconds >= 180) {
+bool ProfileManager::service() {
+    if (!profileLoaded) {
+        return false;
+    }
+    
+    // Refill once every lookup since the last call was past the middle
+    // of the window (oldestUsed is PROFILE_WINDOW if there were none),
+    // or sooner if the lookahead is about to run off its end
+    uint8_t shift = oldestUsed;
+    bool urgent = starved && shift > 0;
+    oldestUsed = PROFILE_WINDOW;
+    starved = false;
+    uint16_t remaining = header.keyframeCount - (windowStart + windowCount);
+    if (remaining == 0 || shift >= windowCount || (shift < PROFILE_WINDOW / 2 && !urgent)) {
+        return false;
+    }
+    
+    TIME_SECTION(SECTION_SD_READ);
+    
+    // Drop keyframes those lookups no longer need
+    memmove(window, window + shift, (windowCount - shift) * sizeof(ProfileKeyframe));
+    windowStart += shift;
+    windowCount -= shift;
+    cursor -= shift;
+    
+    // Read ahead into the freed slots
+    uint8_t want = min(remaining, (uint16_t)(PROFILE_WINDOW - windowCount));
+    int bytes = profileFile.read((uint8_t*)(window + windowCount), want * sizeof(ProfileKeyframe));
+    if (bytes > 0) {
+        windowCount += bytes / sizeof(ProfileKeyframe);
+    }
+    return true;
+}
+
+bool ProfileManager::findSegment(unsigned long timeSeconds, uint32_t* ticks) {
+    if (!profileLoaded || windowCount == 0 || timeSeconds >= header.duration) {
+        return false;
+    }
+    
+    *ticks = timeSeconds * header.sampleRate;
+    
+    // Playback moves forward, so resume from the last segment found;
+    // lookahead lookups leave it a few segments ahead of the present
+    if (cursor >= windowCount) {
+        cursor = 0;
+    }
+    while (cursor > 0 && window[cursor].time > *ticks) {
+        cursor--;
+    }
+    while (cursor + 1 < windowCount && window[cursor + 1].time <= *ticks) {
+        cursor++;
+    }
+    
+    // In the last segment or past the window while more keyframes are
+    // still on the card
+    if (cursor + 2 >= windowCount && windowStart + windowCount < header.keyframeCount) {
+        starved = true;
+        if (cursor + 1 == windowCount && window[cursor].time < *ticks) {
+            underruns++;
+        }
+    }
+    
+    if (cursor < oldestUsed) {
+        oldestUsed = cursor;
+    }
+    return true;
+}
+
+int32_t ProfileManager::interpolate(int32_t from, int32_t to, uint32_t ticks) {
+    const ProfileKeyframe& a = window[cursor];
+    
+    // Hold the value before the first and after the last keyframe
+    if (ticks <= a.time || cursor + 1 >= windowCount) {
+        return from;
+    }
+    const ProfileKeyframe& b = window[cursor + 1];
+    return from + (to - from) * (int32_t)(ticks - a.time) / (int32_t)(b.time - a.time);
+}
+
+temp_t ProfileManager::getTargetTemp(unsigned long timeSeconds) {
+    uint32_t ticks;
+    if (!findSegment(timeSeconds, &ticks)) {
         return 0;
     }
-    return currentProfile.tempCurve[timeSeconds];
+    temp_t next = window[min(cursor + 1, windowCount - 1)].temp;
+    return interpolate(window[cursor].temp, next, ticks);
+}
+
+temp_t ProfileManager::getTargetSlope(unsigned long timeSeconds) {
+    uint32_t ticks;
+    if (!findSegment(timeSeconds, &ticks) || cursor + 1 >= windowCount) {
+        return 0;
+    }
+    
+    // Flat before the first keyframe, as getTargetTemp() holds it there
+    const ProfileKeyframe& a = window[cursor];
+    const ProfileKeyframe& b = window[cursor + 1];
+    if (ticks < a.time) {
+        return 0;
+    }
+    int32_t rise = ((int32_t)b.temp - a.temp) * 60L * header.sampleRate;
+    return tempSaturate(rise / (int32_t)(b.time - a.time));
 }
 
 uint8_t ProfileManager::getTargetFan(unsigned long timeSeconds) {
-    if (!profileLoaded || timeSeconds >= 180) {
+    uint32_t ticks;
+    if (!findSegment(timeSeconds, &ticks)) {
         return 0;
     }
-    return currentProfile.fanCurve[timeSeconds];
+    uint8_t next = window[min(cursor + 1, windowCount - 1)].fan;
+    return interpolate(window[cursor].fan, next, ticks);
 }
 
-int ProfileManager::getProfileList(char names[][PROFILE_NAME_LENGTH]) {
-    int count = 0;
+int ProfileManager::getProfileList(ProfileIndexEntry* entries, int maxEntries, int firstSlot) {
+    if (profileCount == 0 || firstSlot >= MAX_PROFILES || maxEntries <= 0) {
+        return 0;
+    }
     
-    // Iterate through possible profile slots
-    for (int i = 0; i < MAX_PROFILES; i++) {
-        String fileName = getProfileFileName(i);
-        if (SD.exists(fileName)) {
-            // Read profile name
-            profileFile = SD.open(fileName, FILE_READ);
-            if (profileFile) {
-                profileFile.read((uint8_t*)names[count], PROFILE_NAME_LENGTH);
-                profileFile.close();
+    File index = SD.open(PROFILE_INDEX_FILE, FILE_READ);
+    if (!index) {
+        return 0;
+    }
+    
+    // One sequential read from the first requested slot
+    int count = 0;
+    if (index.seek(sizeof(ProfileIndexHeader) + (uint32_t)firstSlot * sizeof(ProfileIndexEntry))) {
+        for (int slot = firstSlot; slot < MAX_PROFILES && count < maxEntries; slot++) {
+            if (index.read((uint8_t*)&entries[count], sizeof(ProfileIndexEntry)) != sizeof(ProfileIndexEntry)) {
+                break;
+            }
+            if (slotUsed(slot)) {
                 count++;
             }
         }
     }
+    index.close();
     
     return count;
 }
 
-RoastProfile* ProfileManager::getCurrentProfile() {
+const RoastProfileHeader* ProfileManager::getCurrentProfile() {
     if (!profileLoaded) {
         return nullptr;
     }
-    return &currentProfile;
+    return &header;
 }
 
 void ProfileManager::createNewProfile() {
-    // Reset current profile
-    memset(&currentProfile, 0, sizeof(RoastProfile));
-    profileLoaded = true;
+    // Start an empty keyframe stream
+    if (recording) {
+        queue->sync(&recordFile);
+        recordFile.close();
+    }
+    SD.remove(PROFILE_RECORD_FILE);
+    recordFile = SD.open(PROFILE_RECORD_FILE, FILE_WRITE);
+    recording = recordFile;
+    recordCount = 0;
+    recordDuration = 0;
+    hasPending = false;
+    openDoor();
 }
 
-void ProfileManager::updateProfilePoint(unsigned long timeSeconds, float temp, uint8_t fan) {
-    if (timeSeconds < 180) {
-        currentProfile.tempCurve[timeSeconds] = temp;
-        currentProfile.fanCurve[timeSeconds] = fan;
-        // Update total time if this is a later point
-        if (timeSeconds / 60 + 1 > currentProfile.totalTime) {
-            currentProfile.totalTime = timeSeconds / 60 + 1;
+void ProfileManager::appendKeyframe(const ProfileKeyframe& frame) {
+    if (recordCount < 0xFFFF
+        && queue->write(&recordFile, (const uint8_t*)&frame, sizeof(frame))) {
+        anchor = frame;
+        recordCount++;
+    }
+}
+
+/**
+ * Slope of the door nearest the given rise over dt ticks, in 1/256 units
+ */
+static int32_t doorSlope(int32_t rise, int32_t dt, int32_t low, int32_t high) {
+    int64_t scaled = (int64_t)rise * 256;
+    if (scaled < (int64_t)low * dt) {
+        return low;
+    }
+    if (scaled > (int64_t)high * dt) {
+        return high;
+    }
+    return rise * 256 / dt;
+}
+
+/**
+ * End the segment on the pending point when the line to it lies inside
+ * the door. Otherwise the line to it can miss a dropped point by more
+ * than the tolerance, so end on the nearest slope the door allows
+ */
+void ProfileManager::flushPending() {
+    if (!hasPending) {
+        return;
+    }
+    int32_t dt = (int32_t)pending.time - anchor.time;
+    int32_t dTemp = (int32_t)pending.temp - anchor.temp;
+    int32_t dFan = (int32_t)pending.fan - anchor.fan;
+    
+    // Rounded to nearest; the door left a unit of room for it
+    ProfileKeyframe end = pending;
+    int32_t tempSlope = doorSlope(dTemp, dt, doorTempLow, doorTempHigh);
+    if (tempSlope != dTemp * 256 / dt) {
+        end.temp = tempSaturate(anchor.temp + (((int64_t)tempSlope * dt + 128) >> 8));
+    }
+    int32_t fanSlope = doorSlope(dFan, dt, doorFanLow, doorFanHigh);
+    if (fanSlope != dFan * 256 / dt) {
+        end.fan = constrain(anchor.fan + (((int64_t)fanSlope * dt + 128) >> 8), 0, 255);
+    }
+    appendKeyframe(end);
+    hasPending = false;
+}
+
+void ProfileManager::openDoor() {
+    doorTempHigh = doorFanHigh = DOOR_OPEN;
+    doorTempLow = doorFanLow = -DOOR_OPEN;
+}
+
+bool ProfileManager::narrowDoor(const ProfileKeyframe& from, const ProfileKeyframe& frame) {
+    // Slopes from the anchor to the top and bottom of this point's
+    // tolerance band, in 1/256 units per tick. Bounds round inward and
+    // the band is one unit narrow, which leaves room for rounding the
+    // stored keyframe and for truncation when playback interpolates
+    int32_t dt = (int32_t)frame.time - from.time;
+    int32_t dTemp = (int32_t)frame.temp - from.temp;
+    int32_t dFan = (int32_t)frame.fan - from.fan;
+    int32_t tempBand = PROFILE_TEMP_TOLERANCE - 1;
+    int32_t fanBand = PROFILE_FAN_TOLERANCE - 1;
+    
+    int32_t tempHigh = min(doorTempHigh, divFloor((dTemp + tempBand) * 256, dt));
+    int32_t tempLow = max(doorTempLow, -divFloor(-(dTemp - tempBand) * 256, dt));
+    int32_t fanHigh = min(doorFanHigh, divFloor((dFan + fanBand) * 256, dt));
+    int32_t fanLow = max(doorFanLow, -divFloor(-(dFan - fanBand) * 256, dt));
+    
+    // A closed door keeps its last range for flushPending()
+    if (tempLow > tempHigh || fanLow > fanHigh) {
+        return false;
+    }
+    doorTempHigh = tempHigh;
+    doorTempLow = tempLow;
+    doorFanHigh = fanHigh;
+    doorFanLow = fanLow;
+    return true;
+}
+
+void ProfileManager::updateProfilePoint(unsigned long timeSeconds, temp_t temp, uint8_t fan) {
+    if (!recording) {
+        return;
+    }
+    
+    // Points are recorded in time order only
+    uint32_t ticks = timeSeconds * PROFILE_SAMPLE_RATE;
+    const ProfileKeyframe* last = hasPending ? &pending : (recordCount > 0 ? &anchor : nullptr);
+    if (ticks > 0xFFFF || (last && ticks <= last->time)) {
+        return;
+    }
+    
+    ProfileKeyframe frame;
+    frame.time = ticks;
+    frame.temp = temp;
+    frame.fan = fan;
+    
+    if (recordCount == 0) {
+        appendKeyframe(frame);
+        openDoor();
+    } else if (!narrowDoor(anchor, frame)) {
+        // No single line from the last keyframe fits every point since it;
+        // end the segment at the previous point and start a new one there
+        flushPending();
+        openDoor();
+        if (narrowDoor(anchor, frame)) {
+            pending = frame;
+            hasPending = true;
+        } else {
+            // Too long a gap for even one point to fit the rounded door
+            appendKeyframe(frame);
         }
+    } else {
+        pending = frame;
+        hasPending = true;
+    }
+    
+    // Update total time if this is a later point
+    if (timeSeconds + 1 > recordDuration) {
+        recordDuration = timeSeconds + 1;
+    }
+}
+
+bool ProfileManager::loadGainSchedule(GainSchedule* schedule) {
+    File file = SD.open(GAIN_SCHEDULE_FILE, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    
+    // Only accept a file written for this table layout
+    GainFileHeader fileHeader;
+    size_t bandBytes = sizeof(temp_t) * GAIN_BAND_COUNT;
+    size_t tableBytes = sizeof(GainSet) * ROAST_STAGE_COUNT * GAIN_BAND_COUNT;
+    bool ok = file.read((uint8_t*)&fileHeader, sizeof(fileHeader)) == sizeof(fileHeader)
+           && fileHeader.magic == GAIN_FILE_MAGIC
+           && fileHeader.version == GAIN_FILE_VERSION
+           && fileHeader.stages == ROAST_STAGE_COUNT
+           && fileHeader.bands == GAIN_BAND_COUNT
+           && file.read((uint8_t*)schedule->getBands(), bandBytes) == (int)bandBytes
+           && file.read((uint8_t*)schedule->getTable(), tableBytes) == (int)tableBytes;
+    file.close();
+    
+    // Breakpoints must be non-negative and ascending for interpolation
+    temp_t* bands = schedule->getBands();
+    for (uint8_t i = 0; ok && i < GAIN_BAND_COUNT; i++) {
+        ok = bands[i] >= 0 && (i == 0 || bands[i] > bands[i - 1]);
     }
+    
+    if (!ok) {
+        schedule->loadDefaults();
+    }
+    return ok;
+}
+
+bool ProfileManager::saveGainSchedule(GainSchedule* schedule) {
+    // FILE_WRITE appends, so start from an empty file
+    if (SD.exists(GAIN_SCHEDULE_FILE)) {
+        SD.remove(GAIN_SCHEDULE_FILE);
+    }
+    File file = SD.open(GAIN_SCHEDULE_FILE, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    
+    GainFileHeader fileHeader;
+    fileHeader.magic = GAIN_FILE_MAGIC;
+    fileHeader.version = GAIN_FILE_VERSION;
+    fileHeader.stages = ROAST_STAGE_COUNT;
+    fileHeader.bands = GAIN_BAND_COUNT;
+    fileHeader.reserved = 0;
+    
+    // A short write leaves a file that loadGainSchedule() rejects
+    size_t bandBytes = sizeof(temp_t) * GAIN_BAND_COUNT;
+    size_t tableBytes = sizeof(GainSet) * ROAST_STAGE_COUNT * GAIN_BAND_COUNT;
+    bool ok = file.write((uint8_t*)&fileHeader, sizeof(fileHeader)) == sizeof(fileHeader)
+           && file.write((uint8_t*)schedule->getBands(), bandBytes) == bandBytes
+           && file.write((uint8_t*)schedule->getTable(), tableBytes) == tableBytes;
+    file.close();
+    
+    return ok;
 }
\ No newline at end of file
@@ -3,40 +3,183 @@
 
 #include <SD.h>
 #include "RoasterConfig.h"
+#include "GainSchedule.h"
+#include "SDWriteQueue.h"
 
+/**
+ * @class ProfileManager
+ * @brief Stores, records and plays back roast profiles on the SD card
+ * 
+ * Playback streams keyframes from the open profile file through a
+ * PROFILE_WINDOW keyframe window. service() refills the window ahead of
+ * the playback cursor between control cycles, so target lookups never
+ * touch the card and profile length is bounded only by card space. The
+ * window spans the present and the setpoint lookahead; a lookup reaching
+ * its last segment has service() refill as soon as a keyframe is free.
+ * Recording appends keyframes to PROFILE_RECORD_FILE through the SD
+ * write queue.
+ */
 class ProfileManager {
     private:
+        SDWriteQueue* queue;
+        
+        // Index: which slots hold a profile, loaded from PROFILE_INDEX_FILE
+        uint8_t slotMap[MAX_PROFILES / 8];
+        uint16_t profileCount;
+        bool indexReady;
+        
+        // Playback
         File profileFile;
-        RoastProfile currentProfile;
+        RoastProfileHeader header;              // Header of the loaded profile
+        ProfileKeyframe window[PROFILE_WINDOW]; // Keyframes around the cursor
+        uint16_t windowStart;       // File index of window[0]
+        uint8_t windowCount;        // Valid keyframes in the window
+        uint8_t cursor;             // Window keyframe starting the last segment looked up
+        uint8_t oldestUsed;         // Lowest cursor since the last service(), PROFILE_WINDOW if none
+        bool starved;               // A lookup since then reached the last segment in the window
+        unsigned long underruns;    // Lookups past the end of the window
         bool profileLoaded;
+        int loadedSlot;             // Slot being played back, -1 if none
+        
+        // Recording
+        File recordFile;
+        ProfileKeyframe anchor;     // Last committed keyframe
+        ProfileKeyframe pending;    // Newest recorded point, not yet committed
+        bool hasPending;
+        bool recording;
+        uint16_t recordCount;       // Keyframes written to the record file
+        uint16_t recordDuration;    // Recorded duration in seconds
+        
+        // Swinging-door recorder: range of slopes from the last keyframe
+        // that keep every point since it within tolerance; a segment ends
+        // on its last point only if the line to it is in this range
+        int32_t doorTempHigh, doorTempLow;
+        int32_t doorFanHigh, doorFanLow;
+        
+        /**
+         * @brief Generate filename for a profile slot
+         */
+        void getProfileFileName(char* buffer, uint16_t slot);
+        
+        /**
+         * @brief Check if a slot holds a profile
+         */
+        bool slotUsed(uint16_t slot);
+        
+        /**
+         * @brief Set or clear a slot in the slot map
+         */
+        void markSlot(uint16_t slot, bool used);
+        
+        /**
+         * @brief Read the index into the slot map
+         * @return false if the index is missing or invalid
+         */
+        bool loadIndex();
+        
+        /**
+         * @brief Create the index from the profile files on the card
+         */
+        bool rebuildIndex();
+        
+        /**
+         * @brief Read one index entry
+         */
+        bool readIndexEntry(uint16_t slot, ProfileIndexEntry* entry);
+        
+        /**
+         * @brief Overwrite one index entry in place
+         */
+        bool writeIndexEntry(const ProfileIndexEntry& entry);
+        
+        /**
+         * @brief CRC-16 and size of a whole file, read from the start
+         */
+        uint16_t checksumFile(File& file, uint32_t* size);
+        
+        /**
+         * @brief Position the cursor on the window segment containing a time
+         * @return false if no profile is loaded or the time is past its end
+         */
+        bool findSegment(unsigned long timeSeconds, uint32_t* ticks);
+        
+        /**
+         * @brief Linear interpolation across the cursor segment
+         */
+        int32_t interpolate(int32_t from, int32_t to, uint32_t ticks);
         
         /**
-         * @brief Generate filename for profile
+         * @brief Write a keyframe to the record file
          */
-        String getProfileFileName(int index);
+        void appendKeyframe(const ProfileKeyframe& frame);
+        
+        /**
+         * @brief Commit the pending recorded point
+         */
+        void flushPending();
+        
+        /**
+         * @brief Reopen the record file for appending after a failed save
+         * @return false, for the save to return
+         */
+        bool resumeRecording();
+        
+        /**
+         * @brief Reset the recorder slope range
+         */
+        void openDoor();
+        
+        /**
+         * @brief Narrow the slope range by one recorded point
+         * @return false if no line from the anchor fits all points
+         */
+        bool narrowDoor(const ProfileKeyframe& from, const ProfileKeyframe& frame);
         
     public:
-        ProfileManager();
+        ProfileManager(SDWriteQueue* sdQueue);
         
         /**
          * @brief Initialize SD card and profile storage
+         * Loads the profile index, rebuilding it if it is missing
          */
         bool begin();
         
         /**
-         * @brief Load profile by index
+         * @brief Load profile by slot and start streaming it
+         * The file must match the size and checksum in the index
          */
-        bool loadProfile(int index);
+        bool loadProfile(int slot);
         
         /**
-         * @brief Save current profile
+         * @brief Save the recorded profile to the first free slot
+         * The index entry is written last, so an interrupted save leaves
+         * the index unchanged. Recording stops only once the entry is
+         * written; after a failure it carries on and the save can be retried
          */
         bool saveProfile(const char* name);
         
+        /**
+         * @brief Remove a profile; its index entry is cleared first
+         */
+        bool deleteProfile(int slot);
+        
+        /**
+         * @brief Refill the playback window ahead of the cursor
+         * Call between control cycles; this is the only place playback reads SD
+         * @return true if the card was accessed
+         */
+        bool service();
+        
         /**
          * @brief Get target temperature for current time
          */
-        float getTargetTemp(unsigned long timeSeconds);
+        temp_t getTargetTemp(unsigned long timeSeconds);
+        
+        /**
+         * @brief Get the slope of the target curve at a time
+         * @return Centi-degrees per minute, 0 outside the profile
+         */
+        temp_t getTargetSlope(unsigned long timeSeconds);
         
         /**
          * @brief Get target fan speed for current time
@@ -44,24 +187,52 @@ class ProfileManager {
         uint8_t getTargetFan(unsigned long timeSeconds);
         
         /**
-         * @brief Get list of available profiles
+         * @brief Get index entries of stored profiles in one pass over the index
+         * @param entries Receives up to maxEntries entries
+         * @param firstSlot Slot to start from, for paging through long lists
+         * @return Number of entries filled in
+         */
+        int getProfileList(ProfileIndexEntry* entries, int maxEntries, int firstSlot = 0);
+        
+        /**
+         * @brief Number of stored profiles
+         */
+        uint16_t getProfileCount() { return profileCount; }
+        
+        /**
+         * @brief Get header of the loaded profile
          */
-        int getProfileList(char names[][PROFILE_NAME_LENGTH]);
+        const RoastProfileHeader* getCurrentProfile();
         
         /**
-         * @brief Get current profile
+         * @brief Number of lookups that found the window not yet refilled
          */
-        RoastProfile* getCurrentProfile();
+        unsigned long getUnderruns() { return underruns; }
         
         /**
-         * @brief Create new profile
+         * @brief Start recording a new profile
          */
         void createNewProfile();
         
         /**
-         * @brief Update profile point
+         * @brief Record a profile point
+         * Points that lie within PROFILE_TEMP_TOLERANCE / PROFILE_FAN_TOLERANCE
+         * of the line between the surrounding keyframes are dropped, and
+         * played back every recorded point is within those tolerances
+         */
+        void updateProfilePoint(unsigned long timeSeconds, temp_t temp, uint8_t fan);
+        
+        /**
+         * @brief Load the PID gain schedule from GAIN_SCHEDULE_FILE
+         * @return true if a valid schedule was loaded; defaults are kept otherwise
+         */
+        bool loadGainSchedule(GainSchedule* schedule);
+        
+        /**
+         * @brief Save the PID gain schedule to GAIN_SCHEDULE_FILE
+         * @return false if the card did not take the whole file
          */
-        void updateProfilePoint(unsigned long timeSeconds, float temp, uint8_t fan);
+        bool saveGainSchedule(GainSchedule* schedule);
 };
 
-#endif
\ No newline at end of file
+#endif
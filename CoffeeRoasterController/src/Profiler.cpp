@@ -0,0 +1,219 @@
+#include "Profiler.h"
+#include "SafetyInterlock.h"
+#include "SDWriteQueue.h"
+
+#ifdef ROASTER_PROFILING
+
+// Report name and time budget of each section
+struct SectionInfo {
+    char name[10];
+    uint16_t budget;            // us; longer runs count as overruns
+};
+
+static const SectionInfo sectionInfo[SECTION_COUNT] PROGMEM = {
+    {"sensors",  1000},
+    {"control",  2000},
+    {"pid",       500},
+    {"log",      1000},
+    {"input",    1000},
+    {"graph",    UI_FRAME_BUDGET_US},
+    {"status",   2000},
+    {"widgets",  UI_FRAME_BUDGET_US},
+    {"sd read",  5000},
+    {"sd write", 5000}
+};
+
+#ifdef __AVR__
+#define STACK_PAINT 0xA5
+
+extern char __heap_start;
+extern char* __brkval;
+
+static char* heapEnd() {
+    return __brkval ? __brkval : &__heap_start;
+}
+#endif
+
+SectionStats Profiler::stats[SECTION_COUNT];
+TaskScheduler* Profiler::scheduler = nullptr;
+SafetyInterlock* Profiler::interlock = nullptr;
+SDWriteQueue* Profiler::sdQueue = nullptr;
+uint8_t Profiler::reportLine = 0;
+bool Profiler::continuous = false;
+unsigned long Profiler::lastReport = 0;
+
+void Profiler::begin(TaskScheduler* taskScheduler, SafetyInterlock* safety,
+                     SDWriteQueue* queue) {
+    scheduler = taskScheduler;
+    interlock = safety;
+    sdQueue = queue;
+    reset();
+    paintStack();
+    scheduler->addTask(reportTask, nullptr, PROFILER_PERIOD, PRIORITY_REPORT);
+}
+
+void Profiler::record(uint8_t section, unsigned long elapsed) {
+    SectionStats& s = stats[section];
+    s.count++;
+    s.total += elapsed;
+    if (elapsed < s.minTime) {
+        s.minTime = elapsed;
+    }
+    if (elapsed > s.maxTime) {
+        s.maxTime = elapsed;
+    }
+    if (elapsed > pgm_read_word(&sectionInfo[section].budget)) {
+        s.overruns++;
+    }
+}
+
+void Profiler::reset() {
+    for (uint8_t i = 0; i < SECTION_COUNT; i++) {
+        stats[i].count = 0;
+        stats[i].total = 0;
+        stats[i].minTime = 0xFFFFFFFFUL;
+        stats[i].maxTime = 0;
+        stats[i].overruns = 0;
+    }
+    if (scheduler) {
+        scheduler->resetStats();
+    }
+    if (sdQueue) {
+        sdQueue->resetStats();
+    }
+}
+
+void Profiler::paintStack() {
+#ifdef __AVR__
+    char* p = heapEnd();
+    char* limit = (char*)SP - PROFILER_STACK_MARGIN;
+    while (p < limit) {
+        *p++ = STACK_PAINT;
+    }
+#endif
+}
+
+int Profiler::freeMemory() {
+#ifdef __AVR__
+    return (char*)SP - heapEnd();
+#else
+    return 0;
+#endif
+}
+
+int Profiler::minFreeMemory() {
+#ifdef __AVR__
+    // The stack grows down into the paint; the first overwritten byte
+    // above the heap is the deepest it has been
+    char* p = heapEnd();
+    while (p < (char*)SP && *(uint8_t*)p == STACK_PAINT) {
+        p++;
+    }
+    return p - heapEnd();
+#else
+    return 0;
+#endif
+}
+
+void Profiler::readCommands() {
+    while (Serial.available() > 0) {
+        switch (Serial.read()) {
+            case 'p':
+                if (reportLine == 0) {
+                    reportLine = 1;
+                }
+                break;
+            case 'c':
+                continuous = !continuous;
+                lastReport = millis() - PROFILER_REPORT_INTERVAL;
+                break;
+            case 'r':
+                reset();
+                break;
+        }
+    }
+}
+
+void Profiler::reportTask(void*) {
+    readCommands();
+
+    unsigned long now = millis();
+    if (continuous && reportLine == 0 && now - lastReport >= PROFILER_REPORT_INTERVAL) {
+        lastReport = now;
+        reportLine = 1;
+    }
+
+    if (reportLine > 0) {
+        reportLine = printLine(reportLine - 1) ? reportLine + 1 : 0;
+    }
+}
+
+// Lines: section header, sections, task header, tasks, safety, SD queue, memory
+bool Profiler::printLine(uint8_t line) {
+    char buffer[64];
+
+    if (line == 0) {
+        Serial.println("section     runs     min     avg     max    over");
+        return true;
+    }
+    line--;
+
+    if (line < SECTION_COUNT) {
+        SectionInfo info;
+        memcpy_P(&info, &sectionInfo[line], sizeof(info));
+        const SectionStats& s = stats[line];
+        sprintf(buffer, "%-9s %6lu %7lu %7lu %7lu %7lu", info.name, s.count,
+                s.count ? s.minTime : 0UL, s.count ? s.total / s.count : 0UL,
+                s.maxTime, s.overruns);
+        Serial.println(buffer);
+        return true;
+    }
+    line -= SECTION_COUNT;
+
+    if (line == 0) {
+        Serial.println("task period    runs    over late ms  max us");
+        return true;
+    }
+    line--;
+
+    if (line < scheduler->getTaskCount()) {
+        const Task* task = scheduler->getTask(line);
+        sprintf(buffer, "%-4u %6u %7lu %7lu %7lu %7lu", line, task->period, task->runs,
+                task->overruns, task->maxLateness, task->maxRunTime);
+        Serial.println(buffer);
+        return true;
+    }
+    line -= scheduler->getTaskCount();
+
+    if (line == 0 && interlock) {
+        snprintf(buffer, sizeof(buffer), "safety max stop %lu us, detect %lu ms, check gap %lu us",
+                 interlock->getMaxStopTime(), interlock->getMaxDetectTime(),
+                 interlock->getMaxCheckGap());
+        Serial.println(buffer);
+        return true;
+    }
+    if (interlock) {
+        line--;
+    }
+
+    if (line == 0 && sdQueue) {
+        snprintf(buffer, sizeof(buffer), "sd queue peak %u B, stall %lu us, dropped %lu B, errors %lu",
+                 sdQueue->getHighWater(), sdQueue->getLongestStall(),
+                 sdQueue->getDroppedBytes(), sdQueue->getWriteErrors());
+        Serial.println(buffer);
+        return true;
+    }
+
+    int freeNow = freeMemory();
+    int freeMin = minFreeMemory();
+#ifdef __AVR__
+    int stackPeak = RAMEND + 1 - (int)(heapEnd() + freeMin);
+#else
+    int stackPeak = 0;
+#endif
+    sprintf(buffer, "sram free %d min %d, stack peak %d", freeNow, freeMin, stackPeak);
+    Serial.println(buffer);
+    return false;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+#include "TaskScheduler.h"
+
+class SafetyInterlock;
+class SDWriteQueue;
+
+// Timed sections of the hot paths
+enum ProfilerSection {
+    SECTION_SENSORS,        // TempControl::sample, both thermocouple reads
+    SECTION_CONTROL,        // RoasterControl::control, whole step
+    SECTION_PID,            // PIDController::compute
+    SECTION_LOG,            // Building and queueing one log record
+    SECTION_INPUT,          // TouchInput::poll
+    SECTION_DRAW_GRAPH,     // Full graph or one new graph column
+    SECTION_DRAW_STATUS,    // One status line
+    SECTION_DRAW_WIDGETS,   // Dirty widgets
+    SECTION_SD_READ,        // Profile window refill
+    SECTION_SD_WRITE,       // One queued buffer written to the card
+    SECTION_COUNT
+};
+
+#ifdef ROASTER_PROFILING
+
+// Timing statistics of one section in us
+struct SectionStats {
+    unsigned long count;
+    unsigned long total;
+    unsigned long minTime;
+    unsigned long maxTime;
+    unsigned long overruns;     // Runs longer than the section budget
+};
+
+/**
+ * @class Profiler
+ * @brief micros() timers around the hot paths and a Serial report
+ *
+ * TIME_SECTION() times the rest of the enclosing block. Building without
+ * ROASTER_PROFILING removes the timers and the report entirely.
+ *
+ * The report is printed one line per run of its task so that Serial,
+ * which blocks once its transmit buffer is full, never holds up the
+ * control tasks for a whole table. It ends with the scheduler task
+ * statistics, the safety interlock's worst reaction times, the SD write
+ * queue's backlog and losses, and the free SRAM; the stack high-water
+ * mark comes from the free RAM painted by begin() that the stack has not
+ * yet overwritten.
+ */
+class Profiler {
+    private:
+        static SectionStats stats[SECTION_COUNT];
+        static TaskScheduler* scheduler;
+        static SafetyInterlock* interlock;
+        static SDWriteQueue* sdQueue;
+        static uint8_t reportLine;      // Next line to print, 0 when idle
+        static bool continuous;
+        static unsigned long lastReport;
+
+        /**
+         * @brief Fill the free RAM between heap and stack with a marker
+         */
+        static void paintStack();
+
+        /**
+         * @brief Handle Serial commands
+         */
+        static void readCommands();
+
+        /**
+         * @brief Print one line of the report
+         * @return false after the last line
+         */
+        static bool printLine(uint8_t line);
+
+        static void reportTask(void* context);
+
+    public:
+        /**
+         * @brief Paint free RAM and register the report task
+         * Call at the end of setup(), once all objects are allocated
+         * @param safety Interlock whose reaction times are reported, if any
+         * @param queue SD write queue whose statistics are reported, if any
+         */
+        static void begin(TaskScheduler* taskScheduler, SafetyInterlock* safety = nullptr,
+                          SDWriteQueue* queue = nullptr);
+
+        /**
+         * @brief Add one timed run to a section
+         */
+        static void record(uint8_t section, unsigned long elapsed);
+
+        /**
+         * @brief Clear section, scheduler and SD queue statistics
+         */
+        static void reset();
+
+        /**
+         * @brief Bytes between the heap and the stack pointer
+         */
+        static int freeMemory();
+
+        /**
+         * @brief Fewest free bytes between heap and stack since begin()
+         */
+        static int minFreeMemory();
+};
+
+// Times from construction to the end of the enclosing block
+class ProfilerScope {
+    private:
+        uint8_t section;
+        unsigned long start;
+
+    public:
+        ProfilerScope(uint8_t timedSection) : section(timedSection), start(micros()) {}
+        ~ProfilerScope() { Profiler::record(section, micros() - start); }
+};
+
+#define TIME_SECTION(section) ProfilerScope profilerScope(section)
+
+#else
+
+// Profiling compiled out
+class Profiler {
+    public:
+        static void begin(TaskScheduler*, SafetyInterlock* = nullptr,
+                          SDWriteQueue* = nullptr) {}
+};
+
+#define TIME_SECTION(section)
+
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+#include "RoastLogger.h"
+
+// Records must tile a block exactly so none straddles a sector
+static_assert(LOG_BLOCK_SIZE % sizeof(RoastLogRecord) == 0, "log records must tile a block");
+static_assert(LOG_BLOCK_SIZE <= SD_QUEUE_BUFFER_SIZE, "a log block must fit a queue buffer");
+
+RoastLogger::RoastLogger(SDWriteQueue* sdQueue) {
+    queue = sdQueue;
+    recordCount = 0;
+    roastNumber = 0;
+    droppedRecords = 0;
+    ready = false;
+    logging = false;
+    memset(&header, 0, sizeof(header));
+}
+
+bool RoastLogger::begin() {
+    // Create logs directory if it doesn't exist
+    if (!SD.exists(LOG_DIRECTORY)) {
+        SD.mkdir(LOG_DIRECTORY);
+    }
+    
+    // Continue numbering after the newest log on the card
+    char fileName[24];
+    roastNumber = 0;
+    for (uint16_t n = 1; n <= LOG_MAX_FILES; n++) {
+        getLogFileName(fileName, n);
+        if (SD.exists(fileName)) {
+            roastNumber = n;
+        }
+    }
+    
+    ready = true;
+    return true;
+}
+
+void RoastLogger::getLogFileName(char* buffer, uint16_t number) {
+    sprintf(buffer, LOG_DIRECTORY "/roast%03u.bin", number);
+}
+
+bool RoastLogger::padBlock(uint32_t position) {
+    static const uint8_t zeros[sizeof(RoastLogRecord)] = {0};
+    
+    // Zeroed records have LOG_FLAG_VALID clear
+    uint16_t remaining = (LOG_BLOCK_SIZE - position % LOG_BLOCK_SIZE) % LOG_BLOCK_SIZE;
+    bool ok = true;
+    while (remaining > 0) {
+        uint16_t count = min(remaining, (uint16_t)sizeof(zeros));
+        ok = queue->write(&logFile, zeros, count) && ok;
+        remaining -= count;
+    }
+    return ok;
+}
+
+bool RoastLogger::startLog(const char* profileName) {
+    if (!ready) {
+        return false;
+    }
+    if (logging) {
+        stopLog();
+    }
+    if (roastNumber >= LOG_MAX_FILES) {
+        return false;
+    }
+    
+    // Opened without O_APPEND so stopLog() can rewrite the header
+    char fileName[24];
+    getLogFileName(fileName, roastNumber + 1);
+    logFile = SD.open(fileName, O_READ | O_WRITE | O_CREAT | O_TRUNC);
+    if (!logFile) {
+        return false;
+    }
+    roastNumber++;
+    
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_MAGIC;
+    header.version = LOG_VERSION;
+    header.recordSize = sizeof(RoastLogRecord);
+    header.blockSize = LOG_BLOCK_SIZE;
+    header.interval = LOG_INTERVAL;
+    header.tempScale = TEMP_SCALE;
+    header.roastNumber = roastNumber;
+    header.recordCount = 0;
+    if (profileName) {
+        strncpy(header.profile, profileName, PROFILE_NAME_LENGTH - 1);
+    }
+    recordCount = 0;
+    droppedRecords = 0;
+    
+    // The header occupies the whole first block so records start aligned.
+    // It is written straight away, like the open, so the queue starts
+    // the roast with both buffers free
+    bool ok = queue->write(&logFile, (const uint8_t*)&header, sizeof(header))
+           && padBlock(sizeof(header));
+    if (!queue->sync(&logFile) || !ok) {
+        logFile.close();
+        return false;
+    }
+    
+    logging = true;
+    return true;
+}
+
+bool RoastLogger::logRecord(const RoastLogRecord& record) {
+    if (!logging) {
+        return false;
+    }
+    
+    RoastLogRecord entry = record;
+    entry.flags |= LOG_FLAG_VALID;
+    
+    // The queue takes all of a record or none, so records stay on the
+    // block grid even when one is dropped
+    if (!queue->write(&logFile, (const uint8_t*)&entry, sizeof(entry))) {
+        droppedRecords++;
+        return false;
+    }
+    recordCount++;
+    return true;
+}
+
+bool RoastLogger::stopLog() {
+    if (!logging) {
+        return false;
+    }
+    logging = false;
+    
+    // Pad the last block to a full sector and write out everything queued
+    bool ok = padBlock(sizeof(RoastLogRecord) * recordCount);
+    ok = queue->sync(&logFile) && ok;
+    
+    // Now the length is known, record it in the header; this one
+    // partial-sector write happens after the roast is over
+    header.recordCount = recordCount;
+    ok = logFile.seek(0)
+      && logFile.write((const uint8_t*)&header, sizeof(header)) == sizeof(header)
+      && ok;
+    
+    logFile.close();
+    return ok;
+}
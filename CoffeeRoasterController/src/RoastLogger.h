@@ -0,0 +1,84 @@
+#ifndef ROAST_LOGGER_H
+#define ROAST_LOGGER_H
+
+#include <SD.h>
+#include "RoasterConfig.h"
+#include "SDWriteQueue.h"
+
+/**
+ * @class RoastLogger
+ * @brief Records every roast to a binary log file on the SD card
+ * 
+ * Records go through the SD write queue, which hands them to the card
+ * a whole sector at a time between control cycles. Logging costs a
+ * struct copy per record, and every card write is one aligned sector.
+ * extras/tools/roastlog2csv.py converts logs to CSV.
+ */
+class RoastLogger {
+    private:
+        SDWriteQueue* queue;
+        File logFile;
+        RoastLogHeader header;          // Header of the open log
+        uint32_t recordCount;           // Records logged this roast
+        uint16_t roastNumber;           // Number of the current or last log
+        unsigned long droppedRecords;   // Records the queue had no room for
+        bool ready;
+        bool logging;
+        
+        /**
+         * @brief Generate filename for a log number
+         */
+        void getLogFileName(char* buffer, uint16_t number);
+        
+        /**
+         * @brief Queue zero bytes up to the next block boundary
+         */
+        bool padBlock(uint32_t position);
+        
+    public:
+        RoastLogger(SDWriteQueue* sdQueue);
+        
+        /**
+         * @brief Prepare the log directory
+         * Call after the SD card has been initialized
+         */
+        bool begin();
+        
+        /**
+         * @brief Open the next roastNNN.bin and write its header block
+         * @param profileName Profile being played back, or nullptr
+         */
+        bool startLog(const char* profileName);
+        
+        /**
+         * @brief Append one record; never touches the card
+         */
+        bool logRecord(const RoastLogRecord& record);
+        
+        /**
+         * @brief Write the final partial block and the record count, then close
+         */
+        bool stopLog();
+        
+        /**
+         * @brief Check if a log file is open
+         */
+        bool isLogging() { return logging; }
+        
+        /**
+         * @brief Number of the current or last log file
+         */
+        uint16_t getRoastNumber() { return roastNumber; }
+        
+        /**
+         * @brief Records logged this roast
+         */
+        uint32_t getRecordCount() { return recordCount; }
+        
+        /**
+         * @brief Records lost because the card fell behind
+         */
+        unsigned long getDroppedRecords() { return droppedRecords; }
+};
+
+#endif
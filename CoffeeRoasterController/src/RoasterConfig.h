@@ -9,6 +9,7 @@
 #include <Wire.h>      // this is needed even tho we aren't using it
 #include <TouchScreen.h>
 #include <LiquidCrystal.h>
+#include "FixedPoint.h"
 
 // SD Card Configuration
 #define SD_CS 53  // Chip Select for SD card on Mega 2560
@@ -19,6 +20,7 @@ class PIDController;
 class DisplayInterface;
 class ProfileManager;
 class RoasterControl;
+class GainSchedule;
 
 //===========================================
 // Hardware Pin Configurations
@@ -27,21 +29,55 @@ class RoasterControl;
 // Display Pins (MCUFRIEND Shield)
 const int XP=7, XM=A1, YP=A2, YM=6; //240x320 ID=0x9341
 const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
+const int TS_RESISTANCE=300;    // Ohms across the X plate
 
 // MAX6675 Temperature Sensor Configuration
-// Sensor 1 - Primary temperature sensor
-#define TEMP1_CS  47    // Chip Select
-#define TEMP1_SCK 46    // Clock
-#define TEMP1_SO  45    // Serial Output (MISO)
-// Sensor 2 - Secondary/verification sensor
-#define TEMP2_CS  44    // Chip Select
-#define TEMP2_SCK 43    // Clock
-#define TEMP2_SO  42    // Serial Output (MISO)
+// Both sensors share the hardware SPI bus with the SD card
+// (SO -> MISO 50, SCK -> SCK 52) and only need their own chip select
+#define TEMP1_CS  47    // Sensor 1 - Bean temperature (BT), in the bean mass
+#define TEMP2_CS  44    // Sensor 2 - Environment temperature (ET), in the drum air
 
-// System Control Pins
-#define HEAT_PIN  50     // PWM output for AC heating element control
-#define FAN_PIN   52     // PWM output for DC fan speed control
-#define EMERGENCY_STOP_PIN 18  // Emergency stop button input
+// System Control Pins (50-53 are reserved for the SPI bus)
+#define HEAT_PIN  48     // SSR drive for the AC heating element (HeaterOutput)
+#define FAN_PIN   46     // Fan PWM on OC5A, driven by Timer5 (FanOutput)
+#define EMERGENCY_STOP_PIN 18  // Emergency stop button input (INT3)
+
+// Heater Output
+// The SSR is switched from a Timer2 interrupt at about the mains half-cycle
+// rate but not locked to it, or from a zero-cross detector when one is
+// fitted. Burst fire needs the detector to switch strictly whole cycles
+#define HEATER_MAINS_HZ 50              // Mains frequency (50 or 60)
+#define HEATER_MODE HEATER_BURST_FIRE   // HEATER_BURST_FIRE or HEATER_TIME_PROPORTIONAL
+#define HEATER_WINDOW 2000              // Time-proportioning window (ms)
+#define HEATER_ZERO_CROSS_PIN 19        // Zero-cross detector input (INT2)
+// #define HEATER_ZERO_CROSS            // Step on zero-cross pulses instead of the timer
+#define HEATER_ZERO_CROSS_TIMEOUT 4     // Half-cycles without a pulse before the heater is cut
+
+// Fan Output
+// Hardware PWM from Timer5 above the audible range; requests are slewed
+// so airflow, and with it heat transfer, never steps
+#define FAN_PWM_FREQUENCY 25000UL       // PWM frequency (Hz), as 4-wire PC fans expect
+#define FAN_SLEW_RATE 128               // Fastest output change in counts per second, 0 for none
+#define FAN_MIN_DUTY 40                 // Lowest output that keeps the fan turning
+
+// Safety Interlock
+// The emergency stop interrupt and a watchdog on Timer2 compare B cut the
+// heater without waiting for the main loop. The watchdog runs once per
+// heater half-cycle tick, 10 ms at 50 Hz
+#define SAFETY_SAMPLE_TIMEOUT 1000      // Oldest sensor sample the heater may run on (ms)
+
+// Roasting stages
+enum RoastStage {
+    IDLE,
+    CHARGING,
+    DRYING,
+    MAILLARD,
+    FIRST_CRACK,
+    DEVELOPMENT,
+    COOLING,
+    EMERGENCY_STOP,
+    ROAST_STAGE_COUNT   // Number of stages, not a stage
+};
 
 //===========================================
 // Display Colors (16-bit RGB565 format)
@@ -62,10 +98,10 @@ const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
 // Safety and Operating Parameters
 //===========================================
 
-// Temperature Safety Limits (in Celsius)
-#define MAX_TEMP 290.0      // Absolute maximum allowed temperature
-#define WARNING_TEMP 280.0  // Temperature to trigger warnings
-#define MIN_TEMP 0.0        // Minimum valid temperature reading
+// Temperature Safety Limits (in whole degrees Celsius, use TEMP_C() to compare)
+#define MAX_TEMP 290        // Absolute maximum allowed temperature
+#define WARNING_TEMP 280    // Temperature to trigger warnings
+#define MIN_TEMP 0          // Minimum valid temperature reading
 
 // PID Control Parameters
 // Aggressive tuning - Used when far from setpoint
@@ -78,6 +114,40 @@ const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
 #define KI_CONS 15.0    // Integral gain
 #define KD_CONS 10.0    // Derivative gain
 
+// Gain Scheduling
+// Gains are interpolated between these |setpoint - temperature| breakpoints (°C)
+#define GAIN_BAND_COUNT 4
+#define GAIN_BAND_1 2
+#define GAIN_BAND_2 TEMP_THRESHOLD
+#define GAIN_BAND_3 15
+#define GAIN_SCHEDULE_FILE "/gains.dat"
+
+// Relay Autotune
+// The heater is switched between bias + swing and bias - swing around
+// the setpoint until the oscillation is steady; gains follow from the
+// ultimate gain and period of that oscillation
+#define AUTOTUNE_SETPOINT 180         // Temperature to oscillate around (°C)
+#define AUTOTUNE_HYSTERESIS 0.5       // Relay switches this far either side of the setpoint (°C)
+#define AUTOTUNE_FAN 128              // Fan output held during the test
+#define AUTOTUNE_MIN_CYCLES 4         // Cycles before the result is accepted
+#define AUTOTUNE_TOLERANCE 10         // Agreement between the last two cycles (%)
+#define AUTOTUNE_MIN_SWING 16         // Smallest relay swing in PWM counts
+#define AUTOTUNE_TIMEOUT 2700000UL    // Give up after this long (ms)
+
+// Profile Tracking
+// In profile mode the setpoint is read ahead by about the heater-to-bean
+// lag, and the profile slope there drives a feed-forward term so the
+// heater starts a ramp before the beans fall behind it
+#define PROFILE_LOOKAHEAD 20          // Setpoint lookahead (s)
+#define FEEDFORWARD_GAIN 6.0          // PWM counts per °C/min of profile slope, 0 disables
+
+// PID Engine Parameters
+#define PID_GAIN_SCALE 256          // Gains are stored as Q8 fixed point
+#define PID_MAX_GAIN 255.0          // Largest gain representable in Q8
+#define PID_MAX_DT 1000             // Longest time step integrated in one compute (ms)
+#define PID_DERIVATIVE_FILTER 2000  // Derivative filter time constant (ms)
+#define PID_TRACKING_TIME 1000      // Anti-windup back-calculation time constant (ms)
+
 //===========================================
 // System Control Parameters
 //===========================================
@@ -87,8 +157,87 @@ const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
 #define PWM_MIN 0       // Minimum PWM value (0% power)
 
 // Control System Parameters
-#define TEMP_THRESHOLD 5.0   // Temperature difference threshold for PID switching
-#define LOG_INTERVAL 1000    // Data logging interval in milliseconds
+#define TEMP_THRESHOLD 5     // Setpoint error beyond which aggressive gains apply (°C)
+#define LOG_INTERVAL 500     // Roast log record interval in milliseconds (2 Hz)
+#define TEMP_SAMPLE_INTERVAL 250  // Sensor sampling interval in ms (MAX6675 converts in ~220 ms)
+
+// Task Scheduling
+// The main loop runs fixed-period tasks; when several are due the one
+// with the lowest priority number runs first
+#define SCHEDULER_MAX_TASKS 10
+#define CONTROL_PERIOD TEMP_SAMPLE_INTERVAL // PID period in ms; every step uses exactly this dt
+#define SAFETY_PERIOD 10                    // Emergency stop polling period in ms
+#define UI_TASK_PERIOD 20                   // Display service period in ms
+#define STORAGE_PERIOD 50                   // SD service period in ms
+#define FAN_RAMP_PERIOD 50                  // Fan slew step period in ms
+
+enum TaskPriority {
+    PRIORITY_SAFETY,
+    PRIORITY_CONTROL,
+    PRIORITY_INPUT,
+    PRIORITY_LOG,
+    PRIORITY_UI,
+    PRIORITY_STORAGE,
+    PRIORITY_REPORT
+};
+
+// Profiling
+// Uncomment to time the hot paths and serve a report over Serial.
+// Send 'p' for one report, 'c' to toggle a report every
+// PROFILER_REPORT_INTERVAL and 'r' to clear the statistics
+// #define ROASTER_PROFILING
+#define PROFILER_PERIOD 50              // Report task period in ms; one report line per run
+#define PROFILER_REPORT_INTERVAL 10000  // Continuous report interval in ms
+#define PROFILER_STACK_MARGIN 64        // Bytes below the stack pointer left unpainted
+
+// Rate of Rise Estimation (least-squares slope over a sliding window)
+#define ROR_SAMPLE_INTERVAL 1000  // Time between RoR samples in ms
+#define ROR_MAX_WINDOW 60         // Longest regression window in samples
+#define ROR_WINDOW 30             // Default regression window in samples
+
+// Temperature Channels
+// Sensor 1 sits in the bean mass (BT) and sensor 2 in the drum air (ET).
+// Each probe has its own filter and RoR; the composite channels combine
+// the two filtered readings and are invalid if either probe faults
+enum TempChannelId {
+    CHANNEL_BT,         // Bean temperature, sensor 1
+    CHANNEL_ET,         // Environment (drum air) temperature, sensor 2
+    CHANNEL_AVERAGE,    // Mean of BT and ET
+    CHANNEL_HOTTEST,    // Hotter of BT and ET
+    CHANNEL_ID_COUNT    // Number of channels, not a channel
+};
+#define TEMP_PROBE_CHANNELS 2     // Channels with a probe of their own
+
+enum TempFilterType {
+    FILTER_NONE,
+    FILTER_EMA,
+    FILTER_KALMAN
+};
+#define BT_FILTER FILTER_KALMAN
+#define ET_FILTER FILTER_EMA
+#define TEMP_EMA_WEIGHT 64              // Weight of a new reading in Q8 (0.25, ~1 s at 4 Hz)
+#define KALMAN_PROCESS_NOISE 64         // Drift variance per sample, centi-°C² (0.08 °C)
+#define KALMAN_MEASUREMENT_NOISE 625    // Reading variance, centi-°C² (one 0.25 °C step)
+
+// Channel each part of the controller reads (see RoasterControl::setChannel)
+enum TempConsumer {
+    CONSUMER_PID,       // PID, autotune and recorded profiles
+    CONSUMER_SAFETY,    // Over-temperature checks and the interlock
+    CONSUMER_DISPLAY,   // Temperature and RoR on screen and in the log
+    CONSUMER_STAGE,     // Stage transitions
+    CONSUMER_COUNT      // Number of consumers, not a consumer
+};
+#define PID_CHANNEL CHANNEL_BT
+#define SAFETY_CHANNEL CHANNEL_HOTTEST
+#define DISPLAY_CHANNEL CHANNEL_BT
+#define STAGE_CHANNEL CHANNEL_BT
+
+// Probe disagreement (whole degrees). ET leads BT while heating, so BT well
+// above ET points at swapped or misplaced probes, and ET far above BT at a
+// probe out of place. Either must last CHANNEL_DISAGREE_TIME to count
+#define CHANNEL_MAX_INVERSION 30        // Largest BT excess over ET
+#define CHANNEL_MAX_SPREAD 220          // Largest ET excess over BT
+#define CHANNEL_DISAGREE_TIME 10000     // ms
 
 //===========================================
 // Display Configuration
@@ -99,8 +248,25 @@ const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
 #define SCREEN_HEIGHT 240    // Display height in pixels
 #define GRAPH_WIDTH 200      // Width of temperature graph
 #define GRAPH_HEIGHT 160     // Height of temperature graph
+#define GRAPH_GRID 20        // Spacing of graph grid lines in pixels
+#define GRAPH_REPAINT_COLUMNS 50 // Graph columns repainted per drawing step
 #define MARGIN 5            // General margin for UI elements
 
+// Display Refresh
+#define UI_REFRESH_INTERVAL 200   // Time between display frames in ms (5 Hz)
+#define UI_FRAME_BUDGET_US 8000   // Drawing time allowed per refresh pass in us
+#define UI_STEP_US 3000           // Longest drawing step; a pass stops when another may not fit
+#define UI_FILL_ROWS 48           // Screen rows filled per drawing step
+
+// Touch Input
+#define TOUCH_MIN_PRESSURE 200        // Readings outside this range are no touch
+#define TOUCH_MAX_PRESSURE 1000
+#define TOUCH_SAMPLE_INTERVAL 25      // Time between panel scans in ms (40 Hz)
+#define TOUCH_DEBOUNCE_SAMPLES 2      // Consecutive scans needed to change state
+#define TOUCH_REPEAT_DELAY 500        // Hold time before the first repeat in ms
+#define TOUCH_REPEAT_INTERVAL 200     // Time between repeats in ms
+#define TOUCH_QUEUE_SIZE 4            // Events waiting for the UI
+
 // Roasting Stage Colors
 #define COLOR_DRYING      0x7BEF  // Light Green  - Drying/Green phase
 #define COLOR_MAILLARD    0xFD20  // Light Orange - Maillard reaction phase
@@ -112,15 +278,122 @@ const int TS_LEFT=937, TS_RT=157, TS_TOP=951, TS_BOT=181; //240x320 ID=0x9341
 //===========================================
 
 // Profile Storage Parameters
-#define MAX_PROFILES 10              // Maximum number of stored profiles
+#define MAX_PROFILES 256             // Profile slots; must be a multiple of 8
 #define PROFILE_NAME_LENGTH 20       // Maximum length of profile names
+#define PROFILE_DIRECTORY "/profiles"
+#define PROFILE_INDEX_FILE "/profiles/index.dat"  // Name, size and checksum of every slot
 
-// Roast Profile Data Structure
-struct RoastProfile {
-    char name[PROFILE_NAME_LENGTH];  // Profile name/identifier
-    float tempCurve[180];           // Temperature points (3 minutes in seconds)
-    uint8_t fanCurve[180];          // Fan speed curve (0-255 for each second)
-    uint8_t totalTime;              // Total roast duration in minutes
-};
+// Profile Format
+// A profile is a header followed by keyframes; targets between keyframes
+// are linearly interpolated, so long roasts need only a few dozen points
+#define PROFILE_MAGIC 0x46525052UL       // "RPRF"
+#define PROFILE_VERSION 2                // Version 1 was the fixed 180-point curve
+#define PROFILE_SAMPLE_RATE 1            // Keyframe time ticks per second
+// Keyframes held in RAM during playback: every one from the present to
+// the setpoint lookahead, with room to refill a few at a time. At 5 bytes
+// a keyframe that is 140 bytes, not a few dozen: a recorded profile can
+// bend every second, so anything smaller lets the lookahead run past the
+// window. A shorter PROFILE_LOOKAHEAD shrinks it
+#define PROFILE_WINDOW (PROFILE_LOOKAHEAD * PROFILE_SAMPLE_RATE + 8)
+#define PROFILE_RECORD_FILE "/profiles/record.tmp"  // Keyframes of the profile being recorded
+#define PROFILE_TEMP_TOLERANCE TEMP_C(1) // Allowed interpolation error when recording
+#define PROFILE_FAN_TOLERANCE 8          // Allowed fan interpolation error when recording
+
+// One profile point
+struct ProfileKeyframe {
+    uint16_t time;                  // Ticks since charge (1 / sampleRate seconds)
+    temp_t temp;                    // Target temperature
+    uint8_t fan;                    // Fan speed (0-255)
+} __attribute__((packed));
+
+// Profile file header
+struct RoastProfileHeader {
+    uint32_t magic;                 // PROFILE_MAGIC
+    uint8_t version;                // PROFILE_VERSION
+    uint8_t sampleRate;             // Keyframe time ticks per second
+    uint16_t duration;              // Total roast duration in seconds
+    uint16_t keyframeCount;         // Keyframes following the header
+    char name[PROFILE_NAME_LENGTH]; // Profile name/identifier
+} __attribute__((packed));
+
+// Profile index
+// One header and MAX_PROFILES entries of 32 bytes. Entries never straddle
+// a sector, so rewriting one is atomic on the card
+#define PROFILE_INDEX_MAGIC 0x58444950UL  // "PIDX"
+#define PROFILE_INDEX_VERSION 1
+#define PROFILE_ENTRY_USED 0x01
+
+struct ProfileIndexHeader {
+    uint32_t magic;                 // PROFILE_INDEX_MAGIC
+    uint8_t version;                // PROFILE_INDEX_VERSION
+    uint8_t entrySize;              // sizeof(ProfileIndexEntry)
+    uint16_t slots;                 // MAX_PROFILES when written
+    uint8_t reserved[24];
+} __attribute__((packed));
+
+struct ProfileIndexEntry {
+    uint8_t flags;                  // PROFILE_ENTRY_USED
+    uint8_t reserved;
+    uint16_t slot;                  // Profile file number
+    char name[PROFILE_NAME_LENGTH]; // Copy of the profile header name
+    uint16_t duration;              // Roast duration in seconds
+    uint32_t size;                  // Profile file size in bytes
+    uint16_t checksum;              // CRC-16/CCITT of the profile file
+} __attribute__((packed));
+
+//===========================================
+// SD Write Queue
+//===========================================
+
+// Writes are collected in two sector buffers and drained one buffer per
+// loop pass, after the heater and safety work is done
+#define SD_QUEUE_BUFFERS 2
+#define SD_QUEUE_BUFFER_SIZE 512     // One SD sector
+
+//===========================================
+// Roast Log
+//===========================================
+
+// Log Format
+// A log is one header block followed by blocks of fixed-size records.
+// Every write is a whole LOG_BLOCK_SIZE sector at a sector-aligned offset,
+// so the card never has to read-modify-write a partial sector
+#define LOG_DIRECTORY "/logs"
+#define LOG_MAX_FILES 999                // Logs are /logs/roastNNN.bin
+#define LOG_BLOCK_SIZE 512               // SD sector size
+#define LOG_MAGIC 0x474F4C52UL           // "RLOG"
+#define LOG_VERSION 1
+
+// Record flags
+#define LOG_FLAG_VALID  0x01             // Cleared in the padding of the last block
+#define LOG_FLAG_MANUAL 0x02             // Manual mode was active
+#define LOG_FLAG_SENSOR 0x04             // A sensor reading was invalid
+#define LOG_FLAG_DISAGREE 0x08           // BT and ET disagreed
+
+// One log record, written every LOG_INTERVAL ms
+struct RoastLogRecord {
+    uint32_t time;                  // Milliseconds since charge
+    temp_t temp1;                   // Sensor 1 (BT), unfiltered
+    temp_t temp2;                   // Sensor 2 (ET), unfiltered
+    temp_t ror;                     // Smoothed rate of rise of the display channel (per minute)
+    temp_t setpoint;                // PID setpoint
+    uint8_t heat;                   // Heater output (0-255)
+    uint8_t fan;                    // Fan output (0-255)
+    uint8_t stage;                  // RoastStage
+    uint8_t flags;                  // LOG_FLAG_*
+} __attribute__((packed));
+
+// Log file header, stored at the start of the first block
+struct RoastLogHeader {
+    uint32_t magic;                 // LOG_MAGIC
+    uint8_t version;                // LOG_VERSION
+    uint8_t recordSize;             // sizeof(RoastLogRecord)
+    uint16_t blockSize;             // LOG_BLOCK_SIZE
+    uint16_t interval;              // LOG_INTERVAL in ms
+    uint16_t tempScale;             // TEMP_SCALE
+    uint16_t roastNumber;           // NNN of roastNNN.bin
+    uint32_t recordCount;           // Records in the file; 0 if the log was not closed
+    char profile[PROFILE_NAME_LENGTH]; // Profile played back, empty in manual mode
+} __attribute__((packed));
 
 #endif // ROASTER_CONFIG_H
@@ -1,13 +1,47 @@
 #include "RoasterControl.h"
+#include "Profiler.h"
+
+// Feed-forward gain in Q8 counts per °C/min
+#define FEEDFORWARD_GAIN_Q8 ((int32_t)(FEEDFORWARD_GAIN * PID_GAIN_SCALE))
+
+static const char probeWarning[] = "PROBES DISAGREE";
+
+static const char* tripMessage(uint8_t reason) {
+    switch (reason) {
+        case TRIP_OVER_TEMP:
+            return "OVER TEMPERATURE!";
+        case TRIP_SENSOR_FAULT:
+            return "SENSOR FAULT!";
+        case TRIP_STALE_SAMPLE:
+            return "CONTROL STALLED!";
+        default:
+            return "EMERGENCY STOP!";
+    }
+}
 
 RoasterControl::RoasterControl(TempControl* temp, PIDController* pid, 
-                             DisplayInterface* disp, ProfileManager* prof) {
+                             DisplayInterface* disp, ProfileManager* prof,
+                             RoastLogger* log, SDWriteQueue* queue,
+                             HeaterOutput* heat, FanOutput* fanOut)
+    : interlock(heat, fanOut) {
     tempControl = temp;
     pidControl = pid;
     display = disp;
     profiles = prof;
+    logger = log;
+    sdQueue = queue;
+    heater = heat;
+    fan = fanOut;
+    handledTrips = 0;
+    channels[CONSUMER_PID] = PID_CHANNEL;
+    channels[CONSUMER_SAFETY] = SAFETY_CHANNEL;
+    channels[CONSUMER_DISPLAY] = DISPLAY_CHANNEL;
+    channels[CONSUMER_STAGE] = STAGE_CHANNEL;
+    probesDisagree = false;
     
     currentStage = IDLE;
+    roastStartTime = 0;
+    stageStartTime = 0;
     emergencyStop = false;
     manualMode = true;
     fanSpeed = 0;
@@ -20,71 +54,254 @@ void RoasterControl::begin() {
     tempControl->begin();
     pidControl->begin();
     display->begin();
-    profiles->begin();
+    if (profiles->begin()) {
+        // Use a tuned gain schedule from SD when one is present
+        profiles->loadGainSchedule(pidControl->getSchedule());
+        logger->begin();
+    }
     
-    // Set up emergency stop pin
-    pinMode(EMERGENCY_STOP_PIN, INPUT_PULLUP);
-    pinMode(HEAT_PIN, OUTPUT);
-    pinMode(FAN_PIN, OUTPUT);
+    // Initial state; heater and fan start off
+    heater->begin();
+    fan->begin();
     
-    // Initial state
-    analogWrite(HEAT_PIN, 0);
-    analogWrite(FAN_PIN, 0);
+    // Emergency stop and watchdog interrupts; the watchdog shares the heater timer
+    interlock.begin();
 }
 
-void RoasterControl::update() {
-    // Check emergency stop
-    if (digitalRead(EMERGENCY_STOP_PIN) == LOW) {
-        handleEmergencyStop();
+void RoasterControl::registerTasks(TaskScheduler* scheduler) {
+    // Sensors and control share a period; sensors were added first, so
+    // on a shared tick the control step sees the fresh sample
+    scheduler->addTask(safetyTask, this, SAFETY_PERIOD, PRIORITY_SAFETY);
+    scheduler->addTask(sensorTask, this, TEMP_SAMPLE_INTERVAL, PRIORITY_CONTROL);
+    scheduler->addTask(controlTask, this, CONTROL_PERIOD, PRIORITY_CONTROL);
+    scheduler->addTask(logTask, this, LOG_INTERVAL, PRIORITY_LOG);
+    scheduler->addTask(displayTask, this, UI_TASK_PERIOD, PRIORITY_UI);
+    scheduler->addTask(storageTask, this, STORAGE_PERIOD, PRIORITY_STORAGE);
+    scheduler->addTask(fanTask, this, FAN_RAMP_PERIOD, PRIORITY_CONTROL);
+}
+
+void RoasterControl::safetyTask(void* self) {
+    RoasterControl* roaster = (RoasterControl*)self;
+    
+    // The interlock has already made the outputs safe; bring the rest of
+    // the roaster to a stop once per trip
+    if (roaster->interlock.getTripCount() != roaster->handledTrips) {
+        roaster->handleEmergencyStop();
+    }
+}
+
+void RoasterControl::sensorTask(void* self) {
+    RoasterControl* roaster = (RoasterControl*)self;
+    roaster->tempControl->sample();
+    roaster->interlock.feed(roaster->readChannel(CONSUMER_SAFETY),
+                            roaster->tempControl->getSnapshot().timestamp);
+}
+
+void RoasterControl::controlTask(void* self) {
+    ((RoasterControl*)self)->control();
+}
+
+void RoasterControl::logTask(void* self) {
+    RoasterControl* roaster = (RoasterControl*)self;
+    if (roaster->isRoasting()) {
+        roaster->logRoastData();
+    }
+}
+
+void RoasterControl::displayTask(void* self) {
+    RoasterControl* roaster = (RoasterControl*)self;
+    roaster->display->setRoasting(roaster->isRoasting());
+    roaster->display->refresh();
+}
+
+void RoasterControl::storageTask(void* self) {
+    RoasterControl* roaster = (RoasterControl*)self;
+    
+    // One read or one buffered write per run so a stalling card delays
+    // at most one run. Writes go first once no buffer is free, or the
+    // next log record would be refused
+    if (roaster->sdQueue->isBacklogged() || !roaster->profiles->service()) {
+        roaster->sdQueue->service();
+    }
+}
+
+void RoasterControl::fanTask(void* self) {
+    ((RoasterControl*)self)->fan->update();
+}
+
+temp_t RoasterControl::readChannel(uint8_t consumer) {
+    return tempControl->getTemp(channels[consumer]);
+}
+
+bool RoasterControl::setChannel(uint8_t consumer, uint8_t channel) {
+    if (consumer >= CONSUMER_COUNT || channel >= CHANNEL_ID_COUNT) {
+        return false;
+    }
+    channels[consumer] = channel;
+    return true;
+}
+
+void RoasterControl::checkProbes() {
+    // BT falls below ET by design once the heat is off
+    bool disagree = tempControl->channelsDisagree() && currentStage != COOLING;
+    if (disagree == probesDisagree) {
+        return;
+    }
+    probesDisagree = disagree;
+    
+    // Never draw over or wipe a warning someone else put up
+    if (disagree && !display->getWarning()) {
+        display->showWarning(probeWarning);
+    } else if (!disagree && display->getWarning() == probeWarning) {
+        display->clearWarning();
+    }
+}
+
+void RoasterControl::control() {
+    if (autotune.isRunning()) {
+        autotuneStep();
         return;
     }
     
     // Only process if roasting
-    if (currentStage != IDLE && currentStage != EMERGENCY_STOP) {
-        // Read temperatures and calculate RoR
-        float currentTemp = tempControl->getAverageTemp();
-        float ror = tempControl->getRateOfRise();
-        
-        // Safety check
-        if (!tempControl->checkSafety()) {
-            handleEmergencyStop();
-            return;
-        }
-        
-        // Update stage based on temperature and time
-        updateStage();
+    if (!isRoasting()) {
+        return;
+    }
+    TIME_SECTION(SECTION_CONTROL);
+    
+    // Temperature the PID steers
+    temp_t currentTemp = readChannel(CONSUMER_PID);
+    
+    // Safety check
+    if (!tempControl->checkSafety(channels[CONSUMER_SAFETY])) {
+        handleEmergencyStop();
+        return;
+    }
+    checkProbes();
+    
+    // Update stage based on temperature and time
+    updateStage();
+    
+    // In profile mode, get target values from profile
+    if (!manualMode) {
+        unsigned long roastTime = (millis() - roastStartTime) / 1000;
+        fanSpeed = profiles->getTargetFan(roastTime);
         
-        // In profile mode, get target values from profile
-        if (!manualMode) {
-            unsigned long roastTime = (millis() - roastStartTime) / 1000;
-            targetTemp = profiles->getTargetTemp(roastTime);
-            fanSpeed = profiles->getTargetFan(roastTime);
+        // Lead the curve by the heater lag, holding the last point at the end
+        unsigned long ahead = roastTime + PROFILE_LOOKAHEAD;
+        const RoastProfileHeader* profile = profiles->getCurrentProfile();
+        if (profile && roastTime < profile->duration && ahead >= profile->duration) {
+            ahead = profile->duration - 1;
         }
+        targetTemp = profiles->getTargetTemp(ahead);
         
-        // PID control for heat
-        pidControl->setSetpoint(targetTemp);
-        pidControl->compute();
-        heatPower = pidControl->getOutput();
-        
-        // Apply controls
-        analogWrite(HEAT_PIN, heatPower);
-        analogWrite(FAN_PIN, fanSpeed);
-        
-        // Update display
-        display->update(currentTemp, ror, fanSpeed, heatPower);
-        
-        // Log data
-        logRoastData();
+        // Power for the coming ramp; the PID trims what the model misses
+        int32_t feedForward = FEEDFORWARD_GAIN_Q8 * profiles->getTargetSlope(ahead)
+                              / ((int32_t)TEMP_SCALE * PID_GAIN_SCALE);
+        pidControl->setFeedForward(constrain(feedForward, -PWM_MAX, PWM_MAX));
+    } else {
+        pidControl->setFeedForward(0);
+    }
+    
+    // PID control for heat; the scheduler runs this every CONTROL_PERIOD
+    pidControl->setSetpoint(targetTemp);
+    pidControl->applySchedule(currentStage, currentTemp);
+    pidControl->compute(currentTemp, CONTROL_PERIOD);
+    heatPower = pidControl->getOutput();
+    
+    // Apply controls
+    heater->setDuty(heatPower);
+    fan->setSpeed(fanSpeed);
+    
+    // Hand new values to the display
+    display->update(readChannel(CONSUMER_DISPLAY),
+                    tempControl->getRateOfRise(channels[CONSUMER_DISPLAY]),
+                    fanSpeed, heatPower);
+}
+
+void RoasterControl::autotuneStep() {
+    TIME_SECTION(SECTION_CONTROL);
+    
+    temp_t currentTemp = readChannel(CONSUMER_PID);
+    if (!tempControl->checkSafety(channels[CONSUMER_SAFETY])) {
+        handleEmergencyStop();
+        return;
+    }
+    
+    heatPower = autotune.update(currentTemp, millis());
+    if (!autotune.isRunning()) {
+        finishAutotune();
+        return;
+    }
+    heater->setDuty(heatPower);
+    fan->setSpeed(fanSpeed);
+    
+    display->update(readChannel(CONSUMER_DISPLAY),
+                    tempControl->getRateOfRise(channels[CONSUMER_DISPLAY]),
+                    fanSpeed, heatPower);
+}
+
+void RoasterControl::finishAutotune() {
+    // Back to idle, as stopAutotune() leaves it
+    heatPower = 0;
+    fanSpeed = 0;
+    targetTemp = 0;
+    heater->off();
+    fan->setSpeed(0);
+    
+    display->clearWarning();
+    if (autotune.getState() != AUTOTUNE_DONE) {
+        display->showWarning("AUTOTUNE FAILED");
+        return;
+    }
+    
+    // Keep the schedule's shape around the new near-setpoint gains; gains
+    // too large for Q8 come back scaled down, which the user should know
+    GainSchedule* schedule = pidControl->getSchedule();
+    bool limited = schedule->retune(autotune.getGains()) || autotune.gainsLimited();
+    if (!profiles->saveGainSchedule(schedule)) {
+        display->showWarning("GAINS NOT SAVED");
+    } else if (limited) {
+        display->showWarning("GAINS SCALED");
+    } else {
+        display->showWarning("AUTOTUNE DONE");
+    }
+}
+
+bool RoasterControl::startAutotune() {
+    if (currentStage != IDLE || autotune.isRunning() || !interlock.reset()) {
+        return false;
+    }
+    
+    targetTemp = TEMP_C(AUTOTUNE_SETPOINT);
+    fanSpeed = AUTOTUNE_FAN;
+    fan->setSpeed(fanSpeed);
+    autotune.start(targetTemp);
+    
+    display->clearWarning();
+    display->showWarning("AUTOTUNE");
+    return true;
+}
+
+void RoasterControl::stopAutotune() {
+    if (autotune.isRunning()) {
+        autotune.cancel();
+        heatPower = 0;
+        fanSpeed = 0;
+        targetTemp = 0;
+        heater->off();
+        fan->setSpeed(0);
+        display->clearWarning();
     }
 }
 
 void RoasterControl::updateStage() {
-    float currentTemp = tempControl->getAverageTemp();
+    temp_t currentTemp = readChannel(CONSUMER_STAGE);
     unsigned long stageTime = (millis() - stageStartTime) / 1000;
     
     switch (currentStage) {
         case CHARGING:
-            if (currentTemp >= 100) {
+            if (currentTemp >= TEMP_C(100)) {
                 currentStage = DRYING;
                 stageStartTime = millis();
                 display->setStageColor(COLOR_DRYING);
@@ -92,7 +309,7 @@ void RoasterControl::updateStage() {
             break;
             
         case DRYING:
-            if (currentTemp >= 160) {
+            if (currentTemp >= TEMP_C(160)) {
                 currentStage = MAILLARD;
                 stageStartTime = millis();
                 display->setStageColor(COLOR_MAILLARD);
@@ -100,7 +317,7 @@ void RoasterControl::updateStage() {
             break;
             
         case MAILLARD:
-            if (currentTemp >= 200) {
+            if (currentTemp >= TEMP_C(200)) {
                 currentStage = FIRST_CRACK;
                 stageStartTime = millis();
                 display->setStageColor(COLOR_FIRST_CRACK);
@@ -121,52 +338,74 @@ void RoasterControl::updateStage() {
 }
 
 void RoasterControl::handleEmergencyStop() {
-    // Cut power to heater
-    analogWrite(HEAT_PIN, 0);
-    // Set fan to full for cooling
-    analogWrite(FAN_PIN, 255);
+    // Latch the interlock: heater locked off, fan forced to full
+    interlock.trip(TRIP_CONTROL);
+    handledTrips = interlock.getTripCount();
+    // Full fan for cooling once the interlock is cleared
+    fan->setSpeed(255);
     
     currentStage = EMERGENCY_STOP;
-    display->showWarning("EMERGENCY STOP!");
+    autotune.cancel();
+    display->showWarning(tripMessage(interlock.getReason()));
     
     // Reset control values
     heatPower = 0;
     fanSpeed = 255;
     targetTemp = 0;
+    
+    // Close the roast log with the stop as its last record
+    if (logger->isLogging()) {
+        logRoastData();
+        logger->stopLog();
+    }
 }
 
 void RoasterControl::startRoast(bool useProfile) {
-    if (currentStage == IDLE || currentStage == EMERGENCY_STOP) {
+    if ((currentStage == IDLE || currentStage == EMERGENCY_STOP) && !autotune.isRunning()) {
+        // No heat until whatever tripped the interlock has cleared
+        if (!interlock.reset()) {
+            return;
+        }
+        
         manualMode = !useProfile;
         currentStage = CHARGING;
         roastStartTime = millis();
         stageStartTime = roastStartTime;
+        pidControl->reset(readChannel(CONSUMER_PID));
+        
+        // Open this roast's log; playback names the profile in its header
+        const RoastProfileHeader* profile = useProfile ? profiles->getCurrentProfile() : nullptr;
+        logger->startLog(profile ? profile->name : nullptr);
         
         // Initial settings
         fanSpeed = 128; // 50% fan to start
-        targetTemp = 100; // Initial target for charging
+        targetTemp = TEMP_C(100); // Initial target for charging
         
         display->setStageColor(COLOR_DRYING);
         display->clearWarning();
+        probesDisagree = false;
     }
 }
 
 void RoasterControl::stopRoast() {
     if (currentStage != IDLE) {
         // Cut heat
-        analogWrite(HEAT_PIN, 0);
+        heater->off();
         // Full fan for cooling
-        analogWrite(FAN_PIN, 255);
+        fan->setSpeed(255);
         
         currentStage = COOLING;
         fanSpeed = 255;
         heatPower = 0;
         
         // After temperature drops below 50°C, stop completely
-        if (tempControl->getAverageTemp() < 50) {
+        temp_t temp = readChannel(CONSUMER_SAFETY);
+        if (temp != TEMP_INVALID && temp < TEMP_C(50)) {
             currentStage = IDLE;
-            analogWrite(FAN_PIN, 0);
+            interlock.reset();
+            fan->setSpeed(0);
             fanSpeed = 0;
+            logger->stopLog();
         }
     }
 }
@@ -175,14 +414,14 @@ void RoasterControl::adjustFan(int8_t adjustment) {
     if (manualMode && currentStage != IDLE && currentStage != EMERGENCY_STOP) {
         int16_t newSpeed = fanSpeed + adjustment;
         fanSpeed = constrain(newSpeed, 0, 255);
-        analogWrite(FAN_PIN, fanSpeed);
+        fan->setSpeed(fanSpeed);
     }
 }
 
 void RoasterControl::adjustHeat(int8_t adjustment) {
     if (manualMode && currentStage != IDLE && currentStage != EMERGENCY_STOP) {
-        int16_t newTarget = targetTemp + adjustment;
-        targetTemp = constrain(newTarget, 0, MAX_TEMP);
+        int32_t newTarget = (int32_t)targetTemp + (int32_t)adjustment * TEMP_SCALE;
+        targetTemp = constrain(newTarget, 0, TEMP_C(MAX_TEMP));
     }
 }
 
@@ -193,18 +432,30 @@ void RoasterControl::toggleManualMode() {
 }
 
 void RoasterControl::logRoastData() {
-    // Log data every LOG_INTERVAL milliseconds
-    static unsigned long lastLog = 0;
+    TIME_SECTION(SECTION_LOG);
+    
     unsigned long now = millis();
     
-    if (now - lastLog >= LOG_INTERVAL) {
-        // If in profile mode, store current values for future replay
-        if (!manualMode) {
-            unsigned long roastTime = (now - roastStartTime) / 1000;
-            profiles->updateProfilePoint(roastTime, 
-                                      tempControl->getAverageTemp(),
-                                      fanSpeed);
-        }
-        lastLog = now;
+    // Full-resolution record for the roast log
+    TempSnapshot snapshot = tempControl->getSnapshot();
+    RoastLogRecord record;
+    record.time = now - roastStartTime;
+    record.temp1 = snapshot.temp1;
+    record.temp2 = snapshot.temp2;
+    record.ror = tempControl->getRateOfRise(channels[CONSUMER_DISPLAY]);
+    record.setpoint = targetTemp;
+    record.heat = heatPower;
+    record.fan = fanSpeed;
+    record.stage = currentStage;
+    record.flags = (manualMode ? LOG_FLAG_MANUAL : 0)
+                 | (snapshot.temp1 == TEMP_INVALID || snapshot.temp2 == TEMP_INVALID ? LOG_FLAG_SENSOR : 0)
+                 | (probesDisagree ? LOG_FLAG_DISAGREE : 0);
+    logger->logRecord(record);
+    
+    // If recording a profile, store current values for future replay
+    if (!manualMode) {
+        profiles->updateProfilePoint(record.time / 1000,
+                                  readChannel(CONSUMER_PID),
+                                  fanSpeed);
     }
-}
\ No newline at end of file
+}
@@ -3,28 +3,31 @@
 
 #include "TempControl.h"
 #include "PIDController.h"
+#include "PIDAutotune.h"
+#include "HeaterOutput.h"
+#include "FanOutput.h"
+#include "SafetyInterlock.h"
 #include "DisplayInterface.h"
 #include "ProfileManager.h"
+#include "RoastLogger.h"
+#include "TaskScheduler.h"
 #include "RoasterConfig.h"
 
-// Roasting stages
-enum RoastStage {
-    IDLE,
-    CHARGING,
-    DRYING,
-    MAILLARD,
-    FIRST_CRACK,
-    DEVELOPMENT,
-    COOLING,
-    EMERGENCY_STOP
-};
-
 class RoasterControl {
     private:
         TempControl* tempControl;
         PIDController* pidControl;
         DisplayInterface* display;
         ProfileManager* profiles;
+        RoastLogger* logger;
+        SDWriteQueue* sdQueue;
+        HeaterOutput* heater;
+        FanOutput* fan;
+        PIDAutotune autotune;
+        SafetyInterlock interlock;
+        uint16_t handledTrips;      // Interlock trips already brought to a stop
+        uint8_t channels[CONSUMER_COUNT]; // TempChannelId each consumer reads
+        bool probesDisagree;        // BT and ET disagreed at the last control step
         
         // System state
         RoastStage currentStage;
@@ -36,7 +39,33 @@ class RoasterControl {
         // Control values
         uint8_t fanSpeed;
         uint8_t heatPower;
-        float targetTemp;
+        temp_t targetTemp;
+        
+        /**
+         * @brief Temperature of the channel a consumer reads
+         * @param consumer TempConsumer
+         */
+        temp_t readChannel(uint8_t consumer);
+        
+        /**
+         * @brief Warn while BT and ET disagree; control carries on
+         */
+        void checkProbes();
+        
+        /**
+         * @brief One control step: safety, stage, targets, PID and outputs
+         */
+        void control();
+        
+        /**
+         * @brief One autotune step in place of the PID
+         */
+        void autotuneStep();
+        
+        /**
+         * @brief Store the tuned gains, or report the failure
+         */
+        void finishAutotune();
         
         /**
          * @brief Update roasting stage based on temperature and time
@@ -53,12 +82,23 @@ class RoasterControl {
          */
         void logRoastData();
         
+        // Scheduler entry points; the context is the RoasterControl
+        static void safetyTask(void* self);
+        static void sensorTask(void* self);
+        static void controlTask(void* self);
+        static void logTask(void* self);
+        static void displayTask(void* self);
+        static void storageTask(void* self);
+        static void fanTask(void* self);
+        
     public:
         /**
          * @brief Constructor
          */
         RoasterControl(TempControl* temp, PIDController* pid, 
-                      DisplayInterface* disp, ProfileManager* prof);
+                      DisplayInterface* disp, ProfileManager* prof,
+                      RoastLogger* log, SDWriteQueue* queue,
+                      HeaterOutput* heat, FanOutput* fanOut);
         
         /**
          * @brief Initialize roaster control system
@@ -66,9 +106,9 @@ class RoasterControl {
         void begin();
         
         /**
-         * @brief Main control loop
+         * @brief Register the periodic control, logging, display and SD tasks
          */
-        void update();
+        void registerTasks(TaskScheduler* scheduler);
         
         /**
          * @brief Start roasting process
@@ -86,7 +126,8 @@ class RoasterControl {
         void adjustFan(int8_t adjustment);
         
         /**
-         * @brief Adjust heat power
+         * @brief Adjust target temperature
+         * @param adjustment Change in whole degrees
          */
         void adjustHeat(int8_t adjustment);
         
@@ -95,11 +136,58 @@ class RoasterControl {
          */
         void toggleManualMode();
         
+        /**
+         * @brief Choose the temperature channel a consumer reads
+         * Best changed between roasts; a new PID channel steps the PID input
+         * @param consumer TempConsumer
+         * @param channel TempChannelId
+         * @return false if either is out of range
+         */
+        bool setChannel(uint8_t consumer, uint8_t channel);
+        
+        /**
+         * @brief Get the TempChannelId a consumer reads
+         */
+        uint8_t getChannel(uint8_t consumer) { return channels[consumer]; }
+        
+        /**
+         * @brief Start a relay autotune around AUTOTUNE_SETPOINT
+         * Only from IDLE; on success the gain schedule is rescaled to the
+         * tuned gains and saved to SD
+         * @return false if the roaster is busy
+         */
+        bool startAutotune();
+        
+        /**
+         * @brief Abandon a running autotune and switch the heater off
+         */
+        void stopAutotune();
+        
+        /**
+         * @brief Check if an autotune is running
+         */
+        bool isAutotuning() { return autotune.isRunning(); }
+        
+        /**
+         * @brief Get the autotuner, e.g. for its identified Ku and Pu
+         */
+        PIDAutotune* getAutotune() { return &autotune; }
+        
+        /**
+         * @brief Get the safety interlock, e.g. for its reaction times
+         */
+        SafetyInterlock* getInterlock() { return &interlock; }
+        
         /**
          * @brief Get current roast stage
          */
         RoastStage getCurrentStage() { return currentStage; }
         
+        /**
+         * @brief Get the temperature the PID is steering to
+         */
+        temp_t getTargetTemp() { return targetTemp; }
+        
         /**
          * @brief Check if roasting is active
          */
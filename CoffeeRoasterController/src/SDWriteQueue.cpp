@@ -0,0 +1,162 @@
+#include "SDWriteQueue.h"
+#include "Profiler.h"
+
+SDWriteQueue::SDWriteQueue() {
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        buffers[i].file = nullptr;
+        buffers[i].length = 0;
+        buffers[i].ready = false;
+        buffers[i].order = 0;
+    }
+    readySequence = 0;
+    queuedBytes = 0;
+    droppedBytes = 0;
+    writeErrors = 0;
+    resetStats();
+}
+
+void SDWriteQueue::resetStats() {
+    highWater = queuedBytes;
+    longestStall = 0;
+}
+
+int8_t SDWriteQueue::findFilling(File* file) {
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        if (buffers[i].file == file && !buffers[i].ready) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int8_t SDWriteQueue::claim(File* file) {
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        if (!buffers[i].file) {
+            buffers[i].file = file;
+            buffers[i].length = 0;
+            buffers[i].ready = false;
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool SDWriteQueue::write(File* file, const uint8_t* source, uint16_t length) {
+    // Take all of the data or none of it, so a producer never leaves a
+    // torn record in the file
+    uint16_t space = 0;
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        if (!buffers[i].file) {
+            space += SD_QUEUE_BUFFER_SIZE;
+        } else if (buffers[i].file == file && !buffers[i].ready) {
+            space += SD_QUEUE_BUFFER_SIZE - buffers[i].length;
+        }
+    }
+    if (length > space) {
+        droppedBytes += length;
+        return false;
+    }
+    
+    while (length > 0) {
+        int8_t index = findFilling(file);
+        if (index < 0) {
+            index = claim(file);
+        }
+        
+        Buffer& buffer = buffers[index];
+        uint16_t count = min(length, (uint16_t)(SD_QUEUE_BUFFER_SIZE - buffer.length));
+        memcpy(data[index] + buffer.length, source, count);
+        buffer.length += count;
+        source += count;
+        length -= count;
+        
+        queuedBytes += count;
+        if (queuedBytes > highWater) {
+            highWater = queuedBytes;
+        }
+        
+        if (buffer.length == SD_QUEUE_BUFFER_SIZE) {
+            markReady(index);
+        }
+    }
+    return true;
+}
+
+void SDWriteQueue::flush(File* file) {
+    int8_t index = findFilling(file);
+    if (index >= 0 && buffers[index].length > 0) {
+        markReady(index);
+    }
+}
+
+void SDWriteQueue::markReady(uint8_t index) {
+    buffers[index].ready = true;
+    buffers[index].order = readySequence++;
+}
+
+int8_t SDWriteQueue::oldestReady(File* file) {
+    // Buffers drain in the order they became ready, which keeps each
+    // file's bytes in sequence
+    int8_t oldest = -1;
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        if (!buffers[i].ready || (file && buffers[i].file != file)) {
+            continue;
+        }
+        if (oldest < 0 || (int8_t)(buffers[i].order - buffers[oldest].order) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+bool SDWriteQueue::drain(uint8_t index) {
+    TIME_SECTION(SECTION_SD_WRITE);
+    
+    Buffer& buffer = buffers[index];
+    
+    unsigned long start = micros();
+    bool ok = buffer.file->write(data[index], buffer.length) == buffer.length;
+    unsigned long elapsed = micros() - start;
+    
+    if (elapsed > longestStall) {
+        longestStall = elapsed;
+    }
+    if (!ok) {
+        writeErrors++;
+    }
+    
+    queuedBytes -= buffer.length;
+    buffer.file = nullptr;
+    buffer.length = 0;
+    buffer.ready = false;
+    return ok;
+}
+
+bool SDWriteQueue::service() {
+    int8_t index = oldestReady(nullptr);
+    if (index < 0) {
+        return false;
+    }
+    drain(index);
+    return true;
+}
+
+bool SDWriteQueue::isBacklogged() {
+    for (uint8_t i = 0; i < SD_QUEUE_BUFFERS; i++) {
+        if (!buffers[i].file) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SDWriteQueue::sync(File* file) {
+    flush(file);
+    
+    bool ok = true;
+    int8_t index;
+    while ((index = oldestReady(file)) >= 0) {
+        ok = drain(index) && ok;
+    }
+    return ok;
+}
@@ -0,0 +1,131 @@
+#ifndef SD_WRITE_QUEUE_H
+#define SD_WRITE_QUEUE_H
+
+#include <SD.h>
+#include "RoasterConfig.h"
+
+/**
+ * @class SDWriteQueue
+ * @brief Write-behind buffering for SD files written during a roast
+ * 
+ * write() only copies into a sector buffer bound to the file. Full or
+ * flushed buffers are handed to the card by service(), at most one
+ * buffer per call, so a card busy with flash housekeeping delays the
+ * loop pass after the heater has been updated, never the update itself.
+ * Each buffer goes out as a single write, so sector-aligned producers
+ * keep their alignment.
+ */
+class SDWriteQueue {
+    private:
+        struct Buffer {
+            File* file;         // Destination, nullptr if free
+            uint16_t length;    // Bytes queued
+            bool ready;         // Full or flushed, waiting for service()
+            uint8_t order;      // Position in the ready queue
+        };
+        
+        uint8_t data[SD_QUEUE_BUFFERS][SD_QUEUE_BUFFER_SIZE];
+        Buffer buffers[SD_QUEUE_BUFFERS];
+        uint8_t readySequence;          // Order stamp for the next ready buffer
+        
+        // Statistics
+        uint16_t queuedBytes;
+        uint16_t highWater;             // Most bytes queued at once
+        unsigned long longestStall;     // Slowest single card write in us
+        unsigned long droppedBytes;     // Bytes refused because both buffers were busy
+        unsigned long writeErrors;      // Buffers the card did not fully accept
+        
+        /**
+         * @brief Find the buffer still filling for a file
+         * @return Buffer index, or -1
+         */
+        int8_t findFilling(File* file);
+        
+        /**
+         * @brief Claim a free buffer for a file
+         * @return Buffer index, or -1
+         */
+        int8_t claim(File* file);
+        
+        /**
+         * @brief Queue a buffer for the card behind those already ready
+         */
+        void markReady(uint8_t index);
+        
+        /**
+         * @brief Find the ready buffer that has waited longest
+         * @param file Only consider this file, or nullptr for any
+         * @return Buffer index, or -1
+         */
+        int8_t oldestReady(File* file);
+        
+        /**
+         * @brief Write one buffer to the card and free it
+         */
+        bool drain(uint8_t index);
+        
+    public:
+        SDWriteQueue();
+        
+        /**
+         * @brief Queue bytes for a file
+         * The File must stay open until the queue has drained it
+         * @return false if the data did not fit; nothing was queued
+         */
+        bool write(File* file, const uint8_t* source, uint16_t length);
+        
+        /**
+         * @brief Mark the file's partially filled buffer ready for the card
+         */
+        void flush(File* file);
+        
+        /**
+         * @brief Write one ready buffer to the card
+         * Call between control cycles
+         * @return true if the card was accessed
+         */
+        bool service();
+        
+        /**
+         * @brief Write everything queued for a file, blocking
+         * For use outside the roast, e.g. before closing the file
+         */
+        bool sync(File* file);
+        
+        /**
+         * @brief Check if every buffer is taken, so the next write may be refused
+         */
+        bool isBacklogged();
+        
+        /**
+         * @brief Bytes waiting for the card
+         */
+        uint16_t getQueuedBytes() { return queuedBytes; }
+        
+        /**
+         * @brief Most bytes waiting at once
+         */
+        uint16_t getHighWater() { return highWater; }
+        
+        /**
+         * @brief Longest single card write in microseconds
+         */
+        unsigned long getLongestStall() { return longestStall; }
+        
+        /**
+         * @brief Bytes refused because the card fell behind
+         */
+        unsigned long getDroppedBytes() { return droppedBytes; }
+        
+        /**
+         * @brief Buffers the card did not fully accept
+         */
+        unsigned long getWriteErrors() { return writeErrors; }
+        
+        /**
+         * @brief Clear the high-water mark and longest stall
+         */
+        void resetStats();
+};
+
+#endif
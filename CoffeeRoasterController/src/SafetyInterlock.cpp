@@ -0,0 +1,179 @@
+#include "SafetyInterlock.h"
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+
+// Half a heater period after compare A, so the two handlers never queue
+ISR(TIMER2_COMPB_vect) {
+    SafetyInterlock::timerTick();
+}
+#endif
+
+SafetyInterlock* SafetyInterlock::active = nullptr;
+
+SafetyInterlock::SafetyInterlock(HeaterOutput* heat, FanOutput* fanOut) {
+    heater = heat;
+    fan = fanOut;
+    reason = TRIP_NONE;
+    latestTemp = TEMP_INVALID;
+    sampleTime = 0;
+    fed = false;
+    lastCheck = 0;
+    trips = 0;
+    maxStopTime = 0;
+    maxDetectTime = 0;
+    maxCheckGap = 0;
+}
+
+void SafetyInterlock::begin() {
+    active = this;
+    
+    pinMode(EMERGENCY_STOP_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(EMERGENCY_STOP_PIN), stopInterrupt, FALLING);
+    
+#ifdef __AVR__
+    noInterrupts();
+    OCR2B = OCR2A / 2;
+    TIFR2 = _BV(OCF2B);
+    TIMSK2 |= _BV(OCIE2B);
+    interrupts();
+#else
+    hal::attachTimer(1000000UL / (2 * HEATER_MAINS_HZ), timerTick);
+#endif
+}
+
+/**
+ * Copy the sample with interrupts off so the watchdog never sees a
+ * temperature from one sample and a time from another
+ */
+void SafetyInterlock::feed(temp_t temp, unsigned long timestamp) {
+    noInterrupts();
+    latestTemp = temp;
+    sampleTime = timestamp;
+    fed = true;
+    interrupts();
+}
+
+/**
+ * The stop and watchdog interrupts latch trips too, so the check and
+ * set of the reason and count must not be split by one of them
+ */
+void SafetyInterlock::trip(uint8_t why) {
+    noInterrupts();
+    latch(why);
+    interrupts();
+}
+
+void SafetyInterlock::latch(uint8_t why) {
+    heater->lock();
+    fan->force(PWM_MAX);
+    if (reason == TRIP_NONE) {
+        reason = why;
+        trips++;
+    }
+}
+
+/**
+ * Check and clear in one critical section, so a trip from an interrupt
+ * can never land between the check and the release of the outputs
+ */
+bool SafetyInterlock::reset() {
+    noInterrupts();
+    uint8_t latched = reason;
+    bool safe = digitalRead(EMERGENCY_STOP_PIN) != LOW
+                && !(fed && (latestTemp == TEMP_INVALID || latestTemp >= TEMP_C(MAX_TEMP)));
+    if (latched != TRIP_NONE && safe) {
+        reason = TRIP_NONE;
+        fan->release();
+        heater->unlock();
+    }
+    interrupts();
+    return latched == TRIP_NONE || safe;
+}
+
+uint16_t SafetyInterlock::getTripCount() {
+    noInterrupts();
+    uint16_t value = trips;
+    interrupts();
+    return value;
+}
+
+void SafetyInterlock::check() {
+    unsigned long nowUs = micros();
+    if (lastCheck != 0 && nowUs - lastCheck > maxCheckGap) {
+        maxCheckGap = nowUs - lastCheck;
+    }
+    lastCheck = nowUs;
+    
+    if (reason != TRIP_NONE) {
+        return;
+    }
+    
+    // A bounce can lose the falling edge; the level is still there
+    if (digitalRead(EMERGENCY_STOP_PIN) == LOW) {
+        latch(TRIP_BUTTON);
+        return;
+    }
+    if (!fed) {
+        return;
+    }
+    
+    // Interrupts are off here, so the sample is consistent
+    uint8_t why = TRIP_NONE;
+    unsigned long age = millis() - sampleTime;
+    if (latestTemp != TEMP_INVALID && latestTemp >= TEMP_C(MAX_TEMP)) {
+        why = TRIP_OVER_TEMP;
+    } else if (heater->getDuty() > 0 && latestTemp == TEMP_INVALID) {
+        why = TRIP_SENSOR_FAULT;
+    } else if (heater->getDuty() > 0 && age > SAFETY_SAMPLE_TIMEOUT) {
+        why = TRIP_STALE_SAMPLE;
+    }
+    
+    if (why != TRIP_NONE) {
+        latch(why);
+        if (age > maxDetectTime) {
+            maxDetectTime = age;
+        }
+    }
+}
+
+unsigned long SafetyInterlock::getMaxStopTime() {
+    noInterrupts();
+    unsigned long value = maxStopTime;
+    interrupts();
+    return value;
+}
+
+unsigned long SafetyInterlock::getMaxDetectTime() {
+    noInterrupts();
+    unsigned long value = maxDetectTime;
+    interrupts();
+    return value;
+}
+
+unsigned long SafetyInterlock::getMaxCheckGap() {
+    noInterrupts();
+    unsigned long value = maxCheckGap;
+    interrupts();
+    return value;
+}
+
+void SafetyInterlock::stopInterrupt() {
+    SafetyInterlock* interlock = active;
+    if (!interlock) {
+        return;
+    }
+    
+    unsigned long start = micros();
+    interlock->latch(TRIP_BUTTON);
+    unsigned long elapsed = micros() - start;
+    if (elapsed > interlock->maxStopTime) {
+        interlock->maxStopTime = elapsed;
+    }
+}
+
+void SafetyInterlock::timerTick() {
+    if (active) {
+        active->check();
+    }
+}
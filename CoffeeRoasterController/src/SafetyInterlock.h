@@ -0,0 +1,142 @@
+#ifndef SAFETY_INTERLOCK_H
+#define SAFETY_INTERLOCK_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+#include "HeaterOutput.h"
+#include "FanOutput.h"
+
+// Why the interlock tripped
+enum TripReason {
+    TRIP_NONE,
+    TRIP_BUTTON,        // Emergency stop pressed
+    TRIP_OVER_TEMP,     // A reading reached MAX_TEMP
+    TRIP_SENSOR_FAULT,  // No valid reading while heating
+    TRIP_STALE_SAMPLE,  // No new sample for SAFETY_SAMPLE_TIMEOUT while heating
+    TRIP_CONTROL        // Stopped by the control loop
+};
+
+/**
+ * @class SafetyInterlock
+ * @brief Heater cut-out that does not depend on the main loop
+ * 
+ * The emergency stop button interrupts on INT3 and the handler locks the
+ * heater off and forces the fan to full before returning. A watchdog on
+ * Timer2 compare B, which runs alongside the heater timer, checks the
+ * latest sensor sample every tick: too hot, no valid reading, or no new
+ * sample for SAFETY_SAMPLE_TIMEOUT while heating (a stalled main loop
+ * or a dead bus) all trip it the same way.
+ * 
+ * A trip is latched. The main loop sees it when getTripCount() moves
+ * past the count it last handled, and runs its own stop handling; the
+ * heater stays locked until reset() finds the button released and the
+ * last sample safe.
+ * 
+ * Reaction times are recorded for the report: time spent in the stop
+ * handler, sample age when the watchdog tripped, and the longest gap
+ * between watchdog checks, which bounds how late a trip can be.
+ */
+class SafetyInterlock {
+    private:
+        static SafetyInterlock* active; // Instance the interrupts act on
+        
+        HeaterOutput* heater;
+        FanOutput* fan;
+        volatile uint8_t reason;        // TripReason, latched
+        volatile temp_t latestTemp;     // Safety channel temperature of the last sample
+        volatile unsigned long sampleTime; // millis() of the last sample
+        volatile bool fed;              // A sample arrived since begin()
+        unsigned long lastCheck;        // micros() of the last watchdog check
+        volatile uint16_t trips;        // Trips since power-up
+        volatile unsigned long maxStopTime;   // Longest stop handler run (us)
+        volatile unsigned long maxDetectTime; // Oldest sample a watchdog trip acted on (ms)
+        volatile unsigned long maxCheckGap;   // Longest gap between watchdog checks (us)
+        
+        /**
+         * @brief Check the latest sample; runs in the timer interrupt
+         */
+        void check();
+        
+        /**
+         * @brief Make the outputs safe and latch the first reason
+         * Interrupts must be off
+         */
+        void latch(uint8_t why);
+        
+    public:
+        /**
+         * @brief Constructor
+         * @param heat Heater to lock off on a trip
+         * @param fanOut Fan to force to full on a trip
+         */
+        SafetyInterlock(HeaterOutput* heat, FanOutput* fanOut);
+        
+        /**
+         * @brief Attach the stop button and start the watchdog
+         * The heater must have begun, since the watchdog shares its timer
+         */
+        void begin();
+        
+        /**
+         * @brief Hand the watchdog a new sensor sample
+         * @param temp Temperature of the channel the safety checks use
+         * @param timestamp millis() when the sensors were read
+         */
+        void feed(temp_t temp, unsigned long timestamp);
+        
+        /**
+         * @brief Lock the heater off and force the fan to full
+         * For the main loop; the interrupt handlers latch directly. The
+         * first reason is kept
+         */
+        void trip(uint8_t why);
+        
+        /**
+         * @brief Clear a trip once it is safe to heat again
+         * @return false if the button is still pressed or the last sample is unsafe
+         */
+        bool reset();
+        
+        /**
+         * @brief Check if a trip is latched
+         */
+        bool isTripped() { return reason != TRIP_NONE; }
+        
+        /**
+         * @brief Get the TripReason of the latched trip
+         */
+        uint8_t getReason() { return reason; }
+        
+        /**
+         * @brief Trips since power-up, read atomically
+         * Compare with the last handled count to see a new trip
+         */
+        uint16_t getTripCount();
+        
+        /**
+         * @brief Longest time from stop interrupt entry to outputs safe (us)
+         */
+        unsigned long getMaxStopTime();
+        
+        /**
+         * @brief Oldest sample age at a watchdog trip (ms)
+         */
+        unsigned long getMaxDetectTime();
+        
+        /**
+         * @brief Longest gap between watchdog checks (us)
+         */
+        unsigned long getMaxCheckGap();
+        
+        /**
+         * @brief Stop button handler; called from the interrupt only
+         */
+        static void stopInterrupt();
+        
+        /**
+         * @brief Watchdog handler; called from the timer interrupt only
+         */
+        static void timerTick();
+};
+
+#endif // SAFETY_INTERLOCK_H
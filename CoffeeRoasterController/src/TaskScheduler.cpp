@@ -0,0 +1,85 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler() {
+    taskCount = 0;
+}
+
+int8_t TaskScheduler::addTask(TaskFunction function, void* context, uint16_t period,
+                              uint8_t priority, uint16_t offset) {
+    if (taskCount >= SCHEDULER_MAX_TASKS || !function || period == 0) {
+        return -1;
+    }
+    
+    Task& task = tasks[taskCount];
+    task.function = function;
+    task.context = context;
+    task.nextRun = millis() + offset;
+    task.period = period;
+    task.priority = priority;
+    task.runs = 0;
+    task.overruns = 0;
+    task.maxLateness = 0;
+    task.maxRunTime = 0;
+    return taskCount++;
+}
+
+bool TaskScheduler::run() {
+    unsigned long now = millis();
+    
+    // Pick the most urgent due task
+    int8_t next = -1;
+    unsigned long nextLateness = 0;
+    for (uint8_t i = 0; i < taskCount; i++) {
+        unsigned long lateness = now - tasks[i].nextRun;
+        if ((long)lateness < 0) {
+            continue;
+        }
+        if (next < 0 || tasks[i].priority < tasks[next].priority
+            || (tasks[i].priority == tasks[next].priority && lateness > nextLateness)) {
+            next = i;
+            nextLateness = lateness;
+        }
+    }
+    if (next < 0) {
+        return false;
+    }
+    
+    Task& task = tasks[next];
+    if (nextLateness > task.maxLateness) {
+        task.maxLateness = nextLateness;
+    }
+    
+    // Keep the fixed cadence; after a whole missed period, restart it from now
+    if (nextLateness >= task.period) {
+        task.overruns += nextLateness / task.period;
+        task.nextRun = now + task.period;
+    } else {
+        task.nextRun += task.period;
+    }
+    
+    unsigned long start = micros();
+    task.function(task.context);
+    unsigned long elapsed = micros() - start;
+    
+    task.runs++;
+    if (elapsed > task.maxRunTime) {
+        task.maxRunTime = elapsed;
+    }
+    return true;
+}
+
+const Task* TaskScheduler::getTask(int8_t id) {
+    if (id < 0 || id >= taskCount) {
+        return nullptr;
+    }
+    return &tasks[id];
+}
+
+void TaskScheduler::resetStats() {
+    for (uint8_t i = 0; i < taskCount; i++) {
+        tasks[i].runs = 0;
+        tasks[i].overruns = 0;
+        tasks[i].maxLateness = 0;
+        tasks[i].maxRunTime = 0;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+
+// Task entry point; context is the pointer given to addTask()
+typedef void (*TaskFunction)(void* context);
+
+// One periodic task and its timing statistics
+struct Task {
+    TaskFunction function;
+    void* context;
+    unsigned long nextRun;      // millis() the next run is due
+    uint16_t period;            // ms
+    uint8_t priority;           // TaskPriority, lower runs first
+    unsigned long runs;
+    unsigned long overruns;     // Periods skipped because the task ran too late
+    unsigned long maxLateness;  // Latest start after the due time in ms
+    unsigned long maxRunTime;   // Longest single run in us
+};
+
+/**
+ * @class TaskScheduler
+ * @brief Cooperative fixed-period scheduler for the main loop
+ * 
+ * Tasks are due at fixed multiples of their period from when they were
+ * added, so start jitter does not accumulate into drift. run() starts the
+ * most urgent due task: lowest priority number first, then the one due
+ * longest. A task that falls a whole period behind skips the missed runs
+ * and counts an overrun. Times are compared by unsigned difference, so
+ * the millis() rollover is harmless.
+ */
+class TaskScheduler {
+    private:
+        Task tasks[SCHEDULER_MAX_TASKS];
+        uint8_t taskCount;
+        
+    public:
+        TaskScheduler();
+        
+        /**
+         * @brief Register a periodic task
+         * @param offset Delay before the first run in ms, to stagger tasks
+         * @return Task id, or -1 if the table is full
+         */
+        int8_t addTask(TaskFunction function, void* context, uint16_t period,
+                       uint8_t priority, uint16_t offset = 0);
+        
+        /**
+         * @brief Run the most urgent due task, if any
+         * @return true if a task ran
+         */
+        bool run();
+        
+        /**
+         * @brief Statistics for a task
+         */
+        const Task* getTask(int8_t id);
+        
+        /**
+         * @brief Number of registered tasks
+         */
+        uint8_t getTaskCount() { return taskCount; }
+        
+        /**
+         * @brief Clear the run, overrun and timing statistics
+         */
+        void resetStats();
+};
+
+#endif
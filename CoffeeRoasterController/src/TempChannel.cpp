@@ -0,0 +1,168 @@
+#include "TempChannel.h"
+
+// Filter state fixed point: temp_t scaled by 256
+#define FILTER_SHIFT 8
+
+TempChannel::TempChannel(uint8_t filterType) {
+    filter = filterType;
+    emaWeight = TEMP_EMA_WEIGHT;
+    processNoise = KALMAN_PROCESS_NOISE;
+    measurementNoise = KALMAN_MEASUREMENT_NOISE;
+    variance = 0;
+    estimate = 0;
+    primed = false;
+    raw = TEMP_INVALID;
+    value = TEMP_INVALID;
+    lastRoRTime = 0;
+    rorHead = 0;
+    rorFill = 0;
+    rorCount = 0;
+    rorWindow = ROR_WINDOW;
+    rorSumY = 0;
+    rorSumXY = 0;
+    lastRoR = 0;
+    instantRoR = 0;
+}
+
+void TempChannel::setFilter(uint8_t filterType) {
+    filter = filterType;
+    primed = false;
+}
+
+void TempChannel::setEmaWeight(uint8_t weight) {
+    emaWeight = max(weight, (uint8_t)1);
+}
+
+void TempChannel::setKalmanNoise(uint16_t process, uint16_t measurement) {
+    processNoise = process;
+    measurementNoise = max(measurement, (uint16_t)1);
+}
+
+/**
+ * Filter the reading, then feed the Rate of Rise window on its cadence
+ */
+void TempChannel::addSample(temp_t reading, unsigned long now) {
+    raw = reading;
+    filterSample(reading);
+    
+    unsigned long timeDiff = now - lastRoRTime;
+    
+    if (rorFill == 0 || timeDiff >= ROR_SAMPLE_INTERVAL) {
+        // Keep a steady cadence unless we fell a whole interval behind
+        if (rorFill == 0 || timeDiff >= 2 * ROR_SAMPLE_INTERVAL) {
+            lastRoRTime = now;
+        } else {
+            lastRoRTime += ROR_SAMPLE_INTERVAL;
+        }
+        addRoRSample(value, timeDiff);
+    }
+}
+
+/**
+ * Both filters move the estimate toward the reading by a gain in Q16:
+ *   x += g * (z - x)
+ * The EMA gain is fixed. The Kalman gain follows the estimate variance:
+ *   P' = P + Q,  g = P' / (P' + R),  P = P' * R / (P' + R)
+ * P' is held below 2^16 so the Q16 gain and the product fit 32 bits
+ */
+void TempChannel::filterSample(temp_t reading) {
+    if (reading == TEMP_INVALID) {
+        primed = false;
+        value = TEMP_INVALID;
+        return;
+    }
+    
+    int32_t measured = (int32_t)reading * (1 << FILTER_SHIFT);
+    if (!primed || filter == FILTER_NONE) {
+        estimate = measured;
+        variance = measurementNoise;
+        primed = true;
+    } else {
+        uint32_t gain;
+        if (filter == FILTER_KALMAN) {
+            uint32_t predicted = min(variance + processNoise, (uint32_t)0xFFFF);
+            gain = (predicted << 16) / (predicted + measurementNoise);
+            variance = predicted * measurementNoise / (predicted + measurementNoise);
+        } else {
+            gain = (uint32_t)emaWeight << (16 - FILTER_SHIFT);
+        }
+        estimate += (int32_t)(((int64_t)gain * (measured - estimate)) >> 16);
+    }
+    value = (estimate + (1 << (FILTER_SHIFT - 1))) >> FILTER_SHIFT;
+}
+
+/**
+ * Add one sample to the regression window in O(1)
+ * With x = 0..n-1 over the window, dropping y0 and appending y gives
+ *   SumXY' = SumXY - (SumY - y0) + (n - 1) * y
+ *   SumY'  = SumY - y0 + y
+ * A faulted reading restarts the window rather than skewing the fit
+ */
+void TempChannel::addRoRSample(temp_t temp, unsigned long interval) {
+    if (temp == TEMP_INVALID) {
+        rorFill = 0;
+        rorCount = 0;
+        rorSumY = 0;
+        rorSumXY = 0;
+        lastRoR = 0;
+        instantRoR = 0;
+        return;
+    }
+    
+    if (rorFill > 0 && interval > 0) {
+        temp_t previous = rorHistory[(rorHead + ROR_MAX_WINDOW - 1) % ROR_MAX_WINDOW];
+        instantRoR = tempRatePerMinute((int32_t)temp - previous, interval);
+    }
+    
+    if (rorCount < rorWindow) {
+        rorSumXY += (int32_t)rorCount * temp;
+        rorSumY += temp;
+        rorCount++;
+    } else {
+        temp_t oldest = rorHistory[(rorHead + ROR_MAX_WINDOW - rorWindow) % ROR_MAX_WINDOW];
+        rorSumXY += (int32_t)(rorWindow - 1) * temp - (rorSumY - oldest);
+        rorSumY += (int32_t)temp - oldest;
+    }
+    
+    rorHistory[rorHead] = temp;
+    rorHead = (rorHead + 1) % ROR_MAX_WINDOW;
+    if (rorFill < ROR_MAX_WINDOW) {
+        rorFill++;
+    }
+    
+    // Least-squares slope per sample:
+    //   (12 * SumXY - 6 * (n - 1) * SumY) / (n * (n^2 - 1))
+    // scaled to centi-degrees per minute; 64-bit only for this final step
+    int32_t n = rorCount;
+    if (n < 2) {
+        lastRoR = 0;
+        return;
+    }
+    int32_t numerator = 12 * rorSumXY - 6 * (n - 1) * rorSumY;
+    int32_t denominator = n * (n * n - 1);
+    lastRoR = tempSaturate((int64_t)numerator * 60000 / ((int64_t)denominator * ROR_SAMPLE_INTERVAL));
+}
+
+/**
+ * Recompute the running sums over the newest rorWindow samples
+ */
+void TempChannel::rebuildRoRSums() {
+    rorCount = min(rorFill, rorWindow);
+    rorSumY = 0;
+    rorSumXY = 0;
+    for (uint8_t i = 0; i < rorCount; i++) {
+        temp_t y = rorHistory[(rorHead + ROR_MAX_WINDOW - rorCount + i) % ROR_MAX_WINDOW];
+        rorSumY += y;
+        rorSumXY += (int32_t)i * y;
+    }
+}
+
+/**
+ * Change the regression window length
+ * Longer windows smooth more but lag more; 15-60 samples suit a roast
+ * @param samples Window length in samples
+ */
+void TempChannel::setRoRWindow(uint8_t samples) {
+    rorWindow = constrain(samples, 2, ROR_MAX_WINDOW);
+    rebuildRoRSums();
+}
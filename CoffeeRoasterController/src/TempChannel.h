@@ -0,0 +1,128 @@
+#ifndef TEMP_CHANNEL_H
+#define TEMP_CHANNEL_H
+
+#include <Arduino.h>
+#include "RoasterConfig.h"
+
+/**
+ * @class TempChannel
+ * @brief One probe's filtered temperature and rate of rise
+ *
+ * Every reading passes through the channel's filter:
+ * - FILTER_NONE passes readings through unchanged
+ * - FILTER_EMA blends each reading in with a fixed Q8 weight
+ * - FILTER_KALMAN is a one-state Kalman filter on a random-walk model.
+ *   Its gain starts at 1 and settles from the process and measurement
+ *   noise, so it follows a fresh probe at once and then smooths like an
+ *   EMA whose weight comes from the noise figures
+ * The filter state is kept scaled by 256 so small steps are not lost to
+ * rounding. An invalid reading restarts the filter.
+ *
+ * Rate of rise is the least-squares slope of the filtered temperature
+ * over a sliding window of ROR_SAMPLE_INTERVAL samples. Running sums of
+ * y and x*y are kept so each new sample updates the fit in constant time.
+ */
+class TempChannel {
+    private:
+        uint8_t filter;             // TempFilterType
+        uint8_t emaWeight;          // Weight of a new reading for FILTER_EMA, Q8
+        uint16_t processNoise;      // Kalman Q, variance added per sample
+        uint16_t measurementNoise;  // Kalman R, variance of one reading
+        uint32_t variance;          // Kalman P, variance of the estimate
+        int32_t estimate;           // Filtered temperature scaled by 256
+        bool primed;                // The estimate holds a valid reading
+        temp_t raw;                 // Last reading as read
+        temp_t value;               // Last filtered reading
+        unsigned long lastRoRTime;  // Timestamp of last RoR sample
+        
+        // Rate of Rise regression state
+        temp_t rorHistory[ROR_MAX_WINDOW]; // RoR samples, ring buffer
+        uint8_t rorHead;            // Next slot to write
+        uint8_t rorFill;            // Valid samples in the ring
+        uint8_t rorCount;           // Samples in the regression window
+        uint8_t rorWindow;          // Regression window length
+        int32_t rorSumY;            // Sum of y over the window
+        int32_t rorSumXY;           // Sum of x*y, x = 0 for the oldest sample
+        temp_t lastRoR;             // Smoothed Rate of Rise
+        temp_t instantRoR;          // Change between the last two samples
+        
+        /**
+         * @brief Run one reading through the filter
+         */
+        void filterSample(temp_t reading);
+        
+        /**
+         * @brief Slide the regression window by one sample
+         */
+        void addRoRSample(temp_t temp, unsigned long interval);
+        
+        /**
+         * @brief Rebuild the running sums from the ring buffer
+         */
+        void rebuildRoRSums();
+    
+    public:
+        /**
+         * @brief Constructor
+         * @param filterType TempFilterType for the readings
+         */
+        TempChannel(uint8_t filterType = FILTER_NONE);
+        
+        /**
+         * @brief Change the filter; the estimate restarts at the next reading
+         * @param filterType TempFilterType
+         */
+        void setFilter(uint8_t filterType);
+        
+        /**
+         * @brief Set the EMA weight of a new reading
+         * @param weight Q8 weight, 1..255; higher follows faster
+         */
+        void setEmaWeight(uint8_t weight);
+        
+        /**
+         * @brief Set the Kalman noise variances in centi-degrees squared
+         * @param process How far the temperature may move per sample
+         * @param measurement How far a reading may be off
+         */
+        void setKalmanNoise(uint16_t process, uint16_t measurement);
+        
+        /**
+         * @brief Add one reading
+         * Feeds the Rate of Rise window every ROR_SAMPLE_INTERVAL
+         * @param reading Temperature, TEMP_INVALID on sensor fault
+         * @param now millis() when the reading was taken
+         */
+        void addSample(temp_t reading, unsigned long now);
+        
+        /**
+         * @brief Get the last reading as read
+         */
+        temp_t getRaw() { return raw; }
+        
+        /**
+         * @brief Get the last filtered reading
+         * @return Temperature, TEMP_INVALID on sensor fault
+         */
+        temp_t getTemp() { return value; }
+        
+        /**
+         * @brief Get the smoothed rate of temperature change
+         * @return Rate of Rise in centi-degrees per minute
+         */
+        temp_t getRateOfRise() { return lastRoR; }
+        
+        /**
+         * @brief Get the change between the last two RoR samples
+         * @return Instantaneous rate in centi-degrees per minute
+         */
+        temp_t getInstantRoR() { return instantRoR; }
+        
+        /**
+         * @brief Set the regression window
+         * @param samples Window length, limited to 2..ROR_MAX_WINDOW
+         */
+        void setRoRWindow(uint8_t samples);
+};
+
+#endif // TEMP_CHANNEL_H
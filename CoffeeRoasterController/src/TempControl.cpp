@@ -1,16 +1,18 @@
 #include "TempControl.h"
+#include "Profiler.h"
 
 /**
  * Constructor: Initialize temperature control system
- * Sets up initial values for temperature tracking
+ * Sets up the BT and ET channels with their configured filters
  */
-TempControl::TempControl(MAX6675 *s1, MAX6675 *s2) {
+TempControl::TempControl(MAX6675SPI *s1, MAX6675SPI *s2) {
     sensor1 = s1;
     sensor2 = s2;
-    lastTemp1 = 0;
-    lastTemp2 = 0;
-    lastRoR = 0;
-    lastTempTime = 0;
+    memset(&snapshot, 0, sizeof(snapshot));
+    channels[CHANNEL_BT].setFilter(BT_FILTER);
+    channels[CHANNEL_ET].setFilter(ET_FILTER);
+    apart = false;
+    apartSince = 0;
 }
 
 /**
@@ -18,66 +20,148 @@ TempControl::TempControl(MAX6675 *s1, MAX6675 *s2) {
  * Includes warm-up delay and initial readings
  */
 void TempControl::begin() {
+    sensor1->begin();
+    sensor2->begin();
     delay(500);  // Allow MAX6675 sensors to stabilize
-    lastTemp1 = readTemp1();
-    lastTemp2 = readTemp2();
-    lastTempTime = millis();
+    sample();
 }
 
 /**
- * Read temperature from sensor 1
- * @return Temperature in Celsius from primary sensor
+ * Sample the sensors once their conversion period has elapsed
+ * Reading a MAX6675 aborts its running conversion, so reading faster
+ * than TEMP_SAMPLE_INTERVAL would only return stale data
+ * @return true if a new snapshot was taken
  */
-float TempControl::readTemp1() {
-    return sensor1->readCelsius();
+bool TempControl::update() {
+    if (millis() - snapshot.timestamp < TEMP_SAMPLE_INTERVAL) {
+        return false;
+    }
+    sample();
+    return true;
 }
 
 /**
- * Read temperature from sensor 2
- * @return Temperature in Celsius from secondary sensor
+ * Read both sensors into the snapshot and hand each to its channel
  */
-float TempControl::readTemp2() {
-    return sensor2->readCelsius();
+void TempControl::sample() {
+    TIME_SECTION(SECTION_SENSORS);
+    
+    snapshot.temp1 = sensor1->readTemp();
+    snapshot.temp2 = sensor2->readTemp();
+    snapshot.timestamp = millis();
+    
+    channels[CHANNEL_BT].addSample(snapshot.temp1, snapshot.timestamp);
+    channels[CHANNEL_ET].addSample(snapshot.temp2, snapshot.timestamp);
+    checkAgreement();
+}
+
+/**
+ * Track how long the filtered channels have been out of agreement
+ * A faulted probe is not a disagreement; checkSafety() catches it
+ */
+void TempControl::checkAgreement() {
+    temp_t bt = channels[CHANNEL_BT].getTemp();
+    temp_t et = channels[CHANNEL_ET].getTemp();
+    bool now = bt != TEMP_INVALID && et != TEMP_INVALID
+               && ((int32_t)bt - et > TEMP_C(CHANNEL_MAX_INVERSION)
+                   || (int32_t)et - bt > TEMP_C(CHANNEL_MAX_SPREAD));
+    if (now && !apart) {
+        apartSince = snapshot.timestamp;
+    }
+    apart = now;
+}
+
+uint8_t TempControl::probeChannel(uint8_t channel) {
+    if (channel == CHANNEL_ET) {
+        return CHANNEL_ET;
+    }
+    if (channel == CHANNEL_HOTTEST
+        && channels[CHANNEL_ET].getTemp() > channels[CHANNEL_BT].getTemp()) {
+        return CHANNEL_ET;
+    }
+    return CHANNEL_BT;
+}
+
+TempChannel* TempControl::getChannel(uint8_t channel) {
+    return channel < TEMP_PROBE_CHANNELS ? &channels[channel] : nullptr;
 }
 
 /**
- * Calculate average temperature from both sensors
- * @return Average temperature in Celsius
+ * Get latest temperature from sensor 1
+ * @return Unfiltered temperature from the BT sensor
  */
-float TempControl::getAverageTemp() {
-    float temp1 = readTemp1();
-    float temp2 = readTemp2();
-    return (temp1 + temp2) / 2.0;
+temp_t TempControl::readTemp1() {
+    return snapshot.temp1;
 }
 
 /**
- * Calculate Rate of Rise (RoR)
- * Measures temperature change rate over time
- * @return Rate of temperature change in °C/second
+ * Get latest temperature from sensor 2
+ * @return Unfiltered temperature from the ET sensor
  */
-float TempControl::getRateOfRise() {
-    float currentTemp = getAverageTemp();
-    unsigned long currentTime = millis();
-    float timeDiff = (currentTime - lastTempTime) / 1000.0; // Convert to seconds
-    
-    // Update RoR calculation every second
-    if (timeDiff >= 1.0) {
-        // Calculate temperature change rate
-        lastRoR = (currentTemp - ((lastTemp1 + lastTemp2) / 2.0)) / timeDiff;
-        // Update historical values
-        lastTemp1 = readTemp1();
-        lastTemp2 = readTemp2();
-        lastTempTime = currentTime;
+temp_t TempControl::readTemp2() {
+    return snapshot.temp2;
+}
+
+/**
+ * Get latest filtered temperature
+ * Composite channels need both probes
+ * @return Temperature of the channel
+ */
+temp_t TempControl::getTemp(uint8_t channel) {
+    if (channel < TEMP_PROBE_CHANNELS) {
+        return channels[channel].getTemp();
     }
-    
-    return lastRoR;
+    temp_t bt = channels[CHANNEL_BT].getTemp();
+    temp_t et = channels[CHANNEL_ET].getTemp();
+    if (bt == TEMP_INVALID || et == TEMP_INVALID) {
+        return TEMP_INVALID;
+    }
+    if (channel == CHANNEL_AVERAGE) {
+        return ((int32_t)bt + et) / 2;
+    }
+    return max(bt, et);
+}
+
+/**
+ * Get Rate of Rise (RoR)
+ * The slope fit is linear, so the average channel's RoR is the mean of
+ * the two; the hottest channel follows whichever probe is hotter
+ * @return Rate of temperature change in centi-degrees per minute
+ */
+temp_t TempControl::getRateOfRise(uint8_t channel) {
+    if (channel == CHANNEL_AVERAGE) {
+        return ((int32_t)channels[CHANNEL_BT].getRateOfRise() + channels[CHANNEL_ET].getRateOfRise()) / 2;
+    }
+    return channels[probeChannel(channel)].getRateOfRise();
+}
+
+/**
+ * Get instantaneous Rate of Rise
+ * Two-point difference of the newest samples, noisy but without lag
+ * @return Rate of temperature change in centi-degrees per minute
+ */
+temp_t TempControl::getInstantRoR(uint8_t channel) {
+    if (channel == CHANNEL_AVERAGE) {
+        return ((int32_t)channels[CHANNEL_BT].getInstantRoR() + channels[CHANNEL_ET].getInstantRoR()) / 2;
+    }
+    return channels[probeChannel(channel)].getInstantRoR();
+}
+
+void TempControl::setRoRWindow(uint8_t samples) {
+    channels[CHANNEL_BT].setRoRWindow(samples);
+    channels[CHANNEL_ET].setRoRWindow(samples);
 }
 
 /**
  * Safety check for maximum temperature
+ * A faulted sensor counts as unsafe
  * @return true if temperature is below MAX_TEMP, false if exceeded
  */
-bool TempControl::checkSafety() {
-    float temp = getAverageTemp();
-    return temp < MAX_TEMP;
+bool TempControl::checkSafety(uint8_t channel) {
+    temp_t temp = getTemp(channel);
+    return temp != TEMP_INVALID && temp < TEMP_C(MAX_TEMP);
+}
+
+bool TempControl::channelsDisagree() {
+    return apart && snapshot.timestamp - apartSince >= CHANNEL_DISAGREE_TIME;
 }
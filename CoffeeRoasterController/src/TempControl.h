@@ -1,32 +1,65 @@
 #ifndef TEMP_CONTROL_H
 #define TEMP_CONTROL_H
 
-#include <max6675.h>
+#include "MAX6675SPI.h"
+#include "TempChannel.h"
 #include "RoasterConfig.h" // Make sure this defines MAX_TEMP
 
+/**
+ * @struct TempSnapshot
+ * @brief One timestamped set of sensor readings shared by all consumers
+ */
+struct TempSnapshot {
+    temp_t temp1;             // Sensor 1 (BT) reading
+    temp_t temp2;             // Sensor 2 (ET) reading
+    unsigned long timestamp;  // millis() when the sensors were read
+};
+
 /**
  * @class TempControl
- * @brief Manages dual temperature sensors and calculates rate of rise
- * 
- * This class handles temperature readings from two MAX6675 sensors,
- * provides averaging, and calculates the rate of temperature change.
+ * @brief Manages the bean (BT) and environment (ET) temperature channels
+ *
+ * This class handles temperature readings from two MAX6675 sensors.
+ * Sensor 1 feeds the BT channel and sensor 2 the ET channel; each has
+ * its own filter and Rate of Rise (see TempChannel). The average and
+ * hotter of the two are available as composite channels, so callers
+ * pick a TempChannelId rather than a sensor.
+ *
+ * The sensors are sampled at most once per TEMP_SAMPLE_INTERVAL by
+ * update(); every other accessor returns cached values, so repeated
+ * calls within a control cycle cost no SPI traffic and do not restart
+ * the MAX6675 conversion. All values are fixed-point temp_t.
+ *
+ * Each sample also checks that the channels agree: BT more than
+ * CHANNEL_MAX_INVERSION above ET, or ET more than CHANNEL_MAX_SPREAD
+ * above BT, for CHANNEL_DISAGREE_TIME is reported by channelsDisagree().
  */
 class TempControl {
     private:
-        MAX6675 *sensor1;           // Primary temperature sensor
-        MAX6675 *sensor2;           // Secondary temperature sensor
-        float lastTemp1;            // Previous reading from sensor 1
-        float lastTemp2;            // Previous reading from sensor 2
-        float lastRoR;              // Last calculated Rate of Rise
-        unsigned long lastTempTime; // Timestamp of last measurement
+        MAX6675SPI *sensor1;        // BT sensor
+        MAX6675SPI *sensor2;        // ET sensor
+        TempSnapshot snapshot;      // Most recent sensor readings
+        TempChannel channels[TEMP_PROBE_CHANNELS]; // BT and ET
+        bool apart;                 // The last sample was out of agreement
+        unsigned long apartSince;   // Timestamp of the first such sample
         
+        /**
+         * @brief Update the disagreement state from the latest sample
+         */
+        void checkAgreement();
+        
+        /**
+         * @brief Probe channel of a channel: itself, the hotter probe or BT
+         */
+        uint8_t probeChannel(uint8_t channel);
+    
     public:
         /**
          * @brief Constructor initializing both temperature sensors
-         * @param s1 Pointer to primary MAX6675 sensor
-         * @param s2 Pointer to secondary MAX6675 sensor
+         * @param s1 Pointer to the BT MAX6675 sensor driver
+         * @param s2 Pointer to the ET MAX6675 sensor driver
          */
-        TempControl(MAX6675 *s1, MAX6675 *s2);
+        TempControl(MAX6675SPI *s1, MAX6675SPI *s2);
         
         /**
          * @brief Initialize sensors and initial readings
@@ -34,34 +67,80 @@ class TempControl {
         void begin();
         
         /**
-         * @brief Read temperature from sensor 1
-         * @return Temperature in Celsius
+         * @brief Sample the sensors if a new conversion is available
+         * @return true if a new snapshot was taken
+         */
+        bool update();
+        
+        /**
+         * @brief Read both sensors now and refresh the snapshot and channels
+         * For callers that already run at TEMP_SAMPLE_INTERVAL
+         */
+        void sample();
+        
+        /**
+         * @brief Get the most recent sensor snapshot
+         * @return Reference to the cached, unfiltered readings
+         */
+        const TempSnapshot& getSnapshot() const { return snapshot; }
+        
+        /**
+         * @brief Get a probe channel to configure its filter or RoR window
+         * @param channel CHANNEL_BT or CHANNEL_ET
+         * @return The channel, nullptr for a composite channel
+         */
+        TempChannel* getChannel(uint8_t channel);
+        
+        /**
+         * @brief Get the latest unfiltered temperature from sensor 1 (BT)
+         * @return Temperature, TEMP_INVALID on sensor fault
+         */
+        temp_t readTemp1();
+        
+        /**
+         * @brief Get the latest unfiltered temperature from sensor 2 (ET)
+         * @return Temperature, TEMP_INVALID on sensor fault
+         */
+        temp_t readTemp2();
+        
+        /**
+         * @brief Get the latest filtered temperature of a channel
+         * @param channel TempChannelId
+         * @return Temperature, TEMP_INVALID if a probe it uses failed
+         */
+        temp_t getTemp(uint8_t channel);
+        
+        /**
+         * @brief Get the smoothed rate of temperature change of a channel
+         * @param channel TempChannelId
+         * @return Rate of Rise in centi-degrees per minute
          */
-        float readTemp1();
+        temp_t getRateOfRise(uint8_t channel = CHANNEL_BT);
         
         /**
-         * @brief Read temperature from sensor 2
-         * @return Temperature in Celsius
+         * @brief Get the change between the last two RoR samples of a channel
+         * @param channel TempChannelId
+         * @return Instantaneous rate in centi-degrees per minute
          */
-        float readTemp2();
+        temp_t getInstantRoR(uint8_t channel = CHANNEL_BT);
         
         /**
-         * @brief Calculate average temperature from both sensors
-         * @return Average temperature in Celsius
+         * @brief Set the regression window of both probe channels
+         * @param samples Window length, limited to 2..ROR_MAX_WINDOW
          */
-        float getAverageTemp();
+        void setRoRWindow(uint8_t samples);
         
         /**
-         * @brief Calculate rate of temperature change
-         * @return Rate of Rise in °C/second
+         * @brief Check if a channel's temperature is within safe limits
+         * @param channel TempChannelId
+         * @return true if temperature is safe, false if exceeded or unreadable
          */
-        float getRateOfRise();
+        bool checkSafety(uint8_t channel);
         
         /**
-         * @brief Check if temperature is within safe limits
-         * @return true if temperature is safe, false if exceeded
+         * @brief Check if BT and ET have disagreed for CHANNEL_DISAGREE_TIME
          */
-        bool checkSafety();
+        bool channelsDisagree();
 };
 
 #endif // TEMP_CONTROL_H
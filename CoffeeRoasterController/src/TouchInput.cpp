@@ -0,0 +1,73 @@
+#include "TouchInput.h"
+#include "Profiler.h"
+
+TouchInput::TouchInput(TouchScreen* touchscreen) {
+    touch = touchscreen;
+    touched = false;
+    changeCount = 0;
+    lastX = 0;
+    lastY = 0;
+    nextRepeat = 0;
+    queueHead = 0;
+    queueCount = 0;
+    overflows = 0;
+}
+
+void TouchInput::poll() {
+    TIME_SECTION(SECTION_INPUT);
+    
+    unsigned long now = millis();
+    
+    // One scan per call
+    TSPoint p = touch->getPoint();
+    
+    // Restore pins that are shared between touch and display
+    pinMode(XM, OUTPUT);
+    pinMode(YP, OUTPUT);
+    
+    bool down = p.z > TOUCH_MIN_PRESSURE && p.z < TOUCH_MAX_PRESSURE;
+    if (down) {
+        // Map touch coordinates to screen coordinates
+        lastX = map(p.x, TS_LEFT, TS_RT, 0, SCREEN_WIDTH);
+        lastY = map(p.y, TS_TOP, TS_BOT, 0, SCREEN_HEIGHT);
+    }
+    
+    // Change state only after enough scans agree
+    if (down == touched) {
+        changeCount = 0;
+    } else if (++changeCount >= TOUCH_DEBOUNCE_SAMPLES) {
+        touched = down;
+        changeCount = 0;
+        push(touched ? TOUCH_PRESS : TOUCH_RELEASE);
+        nextRepeat = now + TOUCH_REPEAT_DELAY;
+        return;
+    }
+    
+    // Auto-repeat while held, but not while a release is being confirmed
+    if (touched && changeCount == 0 && (long)(now - nextRepeat) >= 0) {
+        push(TOUCH_REPEAT);
+        nextRepeat = now + TOUCH_REPEAT_INTERVAL;
+    }
+}
+
+void TouchInput::push(uint8_t type) {
+    if (queueCount >= TOUCH_QUEUE_SIZE) {
+        overflows++;
+        return;
+    }
+    TouchEvent& event = queue[(queueHead + queueCount) % TOUCH_QUEUE_SIZE];
+    event.type = type;
+    event.x = lastX;
+    event.y = lastY;
+    queueCount++;
+}
+
+bool TouchInput::getEvent(TouchEvent* event) {
+    if (queueCount == 0) {
+        return false;
+    }
+    *event = queue[queueHead];
+    queueHead = (queueHead + 1) % TOUCH_QUEUE_SIZE;
+    queueCount--;
+    return true;
+}
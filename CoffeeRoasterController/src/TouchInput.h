@@ -0,0 +1,79 @@
+#ifndef TOUCH_INPUT_H
+#define TOUCH_INPUT_H
+
+#include <TouchScreen.h>
+#include "RoasterConfig.h"
+
+// Kinds of touch event
+enum TouchEventType {
+    TOUCH_PRESS,        // Finger down, after debouncing
+    TOUCH_RELEASE,      // Finger up, after debouncing
+    TOUCH_REPEAT        // Finger still down after TOUCH_REPEAT_DELAY
+};
+
+// One touch event, in screen coordinates
+struct TouchEvent {
+    uint8_t type;       // TouchEventType
+    int16_t x;
+    int16_t y;
+};
+
+/**
+ * @class TouchInput
+ * @brief Debounced touch events from the resistive panel
+ * 
+ * poll() scans the panel once and restores the pins it shares with the
+ * display; the scheduler calls it every TOUCH_SAMPLE_INTERVAL. A press or release is
+ * reported only after TOUCH_DEBOUNCE_SAMPLES agreeing scans, so one tap
+ * produces exactly one press. Events wait in a small queue for the UI.
+ */
+class TouchInput {
+    private:
+        TouchScreen* touch;
+        
+        // Debounce state
+        bool touched;               // Debounced state
+        uint8_t changeCount;        // Consecutive scans disagreeing with it
+        int16_t lastX, lastY;       // Position of the latest touched scan
+        unsigned long nextRepeat;   // millis() of the next repeat while held
+        
+        // Event queue
+        TouchEvent queue[TOUCH_QUEUE_SIZE];
+        uint8_t queueHead;
+        uint8_t queueCount;
+        unsigned long overflows;    // Events lost to a full queue
+        
+        /**
+         * @brief Add an event at the current position
+         */
+        void push(uint8_t type);
+        
+    public:
+        /**
+         * @brief Constructor
+         */
+        TouchInput(TouchScreen* touchscreen);
+        
+        /**
+         * @brief Scan the panel; call every TOUCH_SAMPLE_INTERVAL
+         */
+        void poll();
+        
+        /**
+         * @brief Take the oldest queued event
+         * @return false if there is none
+         */
+        bool getEvent(TouchEvent* event);
+        
+        /**
+         * @brief Check if the panel is currently held
+         */
+        bool isTouched() { return touched; }
+        
+        /**
+         * @brief Events lost because the UI did not keep up
+         */
+        unsigned long getOverflows() { return overflows; }
+};
+
+#endif